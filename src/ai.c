@@ -0,0 +1,276 @@
+/*
+ * AI strategy implementation
+ */
+
+#include <string.h>
+
+#include <SFML/System.h>
+
+#include "ai.h"
+#include "search.h"
+#include "movebuffer.h"
+#include "profiler.h"
+
+aiSettings aiConfig = {0, 0, 0, 0, 0, 16, NULL, NULL};
+
+const aiStrategy aiStrategies[] =
+{
+	{"random", aiRandomMove},
+	{"minopp", aiMinOpponentMoves},
+	{"alphabeta", aiAlphaBeta},
+};
+
+const int aiStrategyCount = sizeof(aiStrategies) / sizeof(aiStrategies[0]);
+
+void aiInit(aiContext *ctx, uint64_t seed)
+{
+	rngSeed(&ctx->r, seed);
+	ctx->stop = NULL;
+	ctx->tt = NULL;
+	ctx->pool = NULL;
+	ctx->history = NULL;
+	ctx->pondering = 0;
+	arenaInit(&ctx->scratch, AI_ARENA_SIZE);
+	aiResetClock(ctx);
+}
+
+void aiFree(aiContext *ctx)
+{
+	ttFree(ctx->tt);
+	ctx->tt = NULL;
+	arenaFree(&ctx->scratch);
+}
+
+void aiSetPool(aiContext *ctx, threadPool *pool)
+{
+	ctx->pool = pool;
+
+	size_t size = searchScratchSize(pool ? threadPoolGetSize(pool) : 1);
+	if (size > ctx->scratch.blockSize)
+	{
+		arenaFree(&ctx->scratch);
+		arenaInit(&ctx->scratch, size);
+	}
+}
+
+void aiNewGame(aiContext *ctx, uint64_t seed)
+{
+	rngSeed(&ctx->r, seed);
+
+	if (ctx->tt)
+		ttClear(ctx->tt);
+
+	aiResetClock(ctx);
+}
+
+void aiResetClock(aiContext *ctx)
+{
+	ctx->clockMs = aiConfig.clockMs;
+}
+
+void aiChargeClock(aiContext *ctx, int elapsedMs)
+{
+	if (!aiConfig.clockMs)
+		return;
+
+	// Running out of time doesn't lose the game, the bot just keeps playing on the smallest possible budget
+	ctx->clockMs += aiConfig.incrementMs - elapsedMs;
+	if (ctx->clockMs < 0)
+		ctx->clockMs = 0;
+}
+
+int aiShouldStop(aiContext *ctx)
+{
+	return ctx->stop && atomic_load_explicit(ctx->stop, memory_order_relaxed);
+}
+
+/////////////////////////////
+// DIFFERENT AI STRATEGIES //
+/////////////////////////////
+
+// Strategy: PICK RANDOM MOVE
+move aiRandomMove(aiContext *ctx, chess *c)
+{
+	moveBuffer moves;
+	moveBufferFromList(&moves, chessGetLegalMoves(c));
+
+	return moves.moves[rngInt(&ctx->r, moves.size)];
+}
+
+typedef struct
+{
+	aiContext *ctx;
+	board *root;
+	moveBuffer *moves;
+	int *responses;
+	board *scratchBoards; // One per worker
+} minOpponentJob;
+
+// Figures out how many responses one root move will let the opponent have. Each root move is independent, so these
+// can run on any worker in any order and the responses are always the same
+static void aiMinOpponentMovesTask(void *userData, int workerIndex, int moveIndex)
+{
+	minOpponentJob *job = (minOpponentJob *) userData;
+
+	if (aiShouldStop(job->ctx))
+	{
+		job->responses[moveIndex] = 0;
+		return;
+	}
+
+	board *scratchBoard = &job->scratchBoards[workerIndex];
+	memcpy(scratchBoard, job->root, sizeof(board));
+
+	boardPlayMoveInPlace(scratchBoard, job->moves->moves[moveIndex]);
+
+	moveBuffer responses;
+	moveBufferGenerate(&responses, scratchBoard);
+
+	job->responses[moveIndex] = responses.size;
+}
+
+// Strategy: MINIMIZE OPPONENTS MOVES
+// It will play a random move such that the number of responses is minimized
+move aiMinOpponentMoves(aiContext *ctx, chess *c)
+{
+	moveBuffer moves;
+	moveBufferFromList(&moves, chessGetLegalMoves(c));
+
+	int size = moves.size;
+	int numWorkers = ctx->pool ? threadPoolGetSize(ctx->pool) : 1;
+
+	arenaReset(&ctx->scratch);
+
+	minOpponentJob job;
+	job.ctx = ctx;
+	job.root = chessGetBoard(c);
+	job.moves = &moves;
+	job.responses = (int *) arenaAlloc(&ctx->scratch, size * sizeof(int));
+	job.scratchBoards = (board *) arenaAlloc(&ctx->scratch, numWorkers * sizeof(board));
+
+	if (ctx->pool)
+	{
+		threadPoolRun(ctx->pool, aiMinOpponentMovesTask, &job, size);
+	}
+	else
+	{
+		for (int i = 0; i < size; i++)
+			aiMinOpponentMovesTask(&job, 0, i);
+	}
+
+	int *responses = job.responses;
+
+	if (aiShouldStop(ctx))
+		return moves.moves[0];
+
+	// Determine what the number of least responses and how many there are
+	int leastResponses = 1000000;
+	int leastResponsesCount = 0;
+
+	for (int i = 0; i < size; i++)
+	{
+		if (responses[i] < leastResponses)
+		{
+			leastResponses = responses[i];
+			leastResponsesCount = 1;
+		}
+		else if (responses[i] == leastResponses)
+		{
+			leastResponsesCount++;
+		}
+	}
+
+	// Now that we know how many, pick a random move out of those moves
+	int randIndex = rngInt(&ctx->r, leastResponsesCount);
+
+	// Move to the first move with the least number of responses
+	int moveIndex = 0;
+	while (responses[moveIndex] > leastResponses)
+		moveIndex++;
+
+	// Move to the next index where the random move is
+	for (int i = 0; i < randIndex; i++)
+	{
+		moveIndex++;
+
+		while (responses[moveIndex] > leastResponses)
+			moveIndex++;
+	}
+
+	// Play the given move
+	return moves.moves[moveIndex];
+}
+
+// Strategy: ALPHA-BETA SEARCH
+// Searches as deep as the --depth, --nodes and --movetime limits or the --clock allow, and plays the best move found
+move aiAlphaBeta(aiContext *ctx, chess *c)
+{
+	if (!ctx->tt)
+		ctx->tt = ttCreate(aiConfig.hashSizeMb);
+
+	searchLimits limits;
+	limits.depth = aiConfig.searchDepth;
+	limits.nodes = aiConfig.searchNodes;
+	limits.timeMs = aiConfig.moveTimeMs;
+	limits.multiPv = 0;
+	limits.onIteration = NULL;
+	limits.userData = NULL;
+	if (aiConfig.clockMs)
+		limits.timeMs = searchTimeForMove(ctx->clockMs, aiConfig.incrementMs, 0, 0);
+	if (!limits.depth && !limits.nodes && !limits.timeMs)
+		limits.depth = AI_DEFAULT_SEARCH_DEPTH;
+
+	if (!aiConfig.clockMs)
+		return searchRun(ctx, c, limits).best;
+
+	sfClock *clock = sfClock_create();
+	move m = searchRun(ctx, c, limits).best;
+
+	// A search which was stopped is thrown away, and a ponder search is charged by whoever turns it into the real one
+	if (!aiShouldStop(ctx) && !ctx->pondering)
+		aiChargeClock(ctx, sfTime_asMilliseconds(sfClock_getElapsedTime(clock)));
+
+	sfClock_destroy(clock);
+	return m;
+}
+
+const aiStrategy *aiFindStrategy(const char *name)
+{
+	for (int i = 0; i < aiStrategyCount; i++)
+	{
+		if (strcmp(aiStrategies[i].name, name) == 0)
+			return &aiStrategies[i];
+	}
+
+	return NULL;
+}
+
+// This is the function which determines which strategy the AI will use
+move aiGetMove(aiContext *ctx, chess *c)
+{
+	const aiStrategy *strategy = aiConfig.strategy;
+
+	// Giving the search a limit on the command line turns it on
+	int hasLimit = aiConfig.searchDepth || aiConfig.searchNodes || aiConfig.moveTimeMs || aiConfig.clockMs;
+	if (!strategy)
+		strategy = aiFindStrategy(hasLimit ? "alphabeta" : "random");
+
+	return aiGetMoveWith(ctx, c, strategy);
+}
+
+move aiGetMoveWith(aiContext *ctx, chess *c, const aiStrategy *strategy)
+{
+	int64_t start = profileBegin();
+
+	move m;
+	if (aiConfig.book && bookProbe(aiConfig.book, chessGetBoard(c), &ctx->r, &m))
+	{
+		profileEnd(pzAiMove, start);
+		return m;
+	}
+
+	m = strategy->getMove(ctx, c);
+
+	profileEnd(pzAiMove, start);
+	return m;
+}
@@ -0,0 +1,120 @@
+/*
+ * AI strategy declarations
+ */
+
+#ifndef AI_H
+#define AI_H
+
+#include <stdatomic.h>
+
+#include "chesslib/chess.h"
+
+#include "rng.h"
+#include "tt.h"
+#include "threadpool.h"
+#include "arena.h"
+#include "book.h"
+#include "keyhistory.h"
+
+// Big enough for a whole search on one thread. aiSetPool adds room for more threads
+#define AI_ARENA_SIZE (1024 * 1024)
+
+// How deep aiAlphaBeta searches when it is picked by name without a --depth, --nodes, --movetime or --clock limit
+#define AI_DEFAULT_SEARCH_DEPTH 4
+
+typedef struct aiStrategy aiStrategy;
+
+// Settings shared by every context. These are set once from the command line, before any search starts
+typedef struct
+{
+	int searchDepth; // 0 means no limit
+	unsigned long long searchNodes; // 0 means no limit
+	int moveTimeMs; // 0 means no limit
+	int clockMs; // Time for a whole game, 0 means no clock
+	int incrementMs; // Added to the clock after every move
+	int hashSizeMb;
+	openingBook *book; // NULL if no book was given
+	const aiStrategy *strategy; // NULL picks one based on the search limits
+} aiSettings;
+
+extern aiSettings aiConfig;
+
+// Per-thread state used by the strategies. A strategy only ever reads the game it is given, so several threads can
+// each run their own game with their own context at the same time
+typedef struct
+{
+	rng r;
+
+	// Set by another thread to ask a running strategy to give up early. May be NULL if the search is never cancelled
+	atomic_int *stop;
+
+	// Created the first time a search strategy runs with this context, and kept between moves
+	ttTable *tt;
+
+	// Strategies which can split their work use this pool. May be NULL, in which case they run on the calling thread.
+	// Set with aiSetPool
+	threadPool *pool;
+
+	// Scratch memory for the strategies. Each strategy resets it when it starts, and allocates every buffer of its own
+	// for the move from here. Moves are generated into moveBuffers on the stack, so once the arena is big enough a
+	// strategy never touches the heap
+	arena scratch;
+
+	// Time left on this context's clock in the current game, if there is one
+	int clockMs;
+
+	// Set while searching the position after a guess of the opponent's move. Such a search doesn't charge the clock,
+	// since the opponent is still thinking and the guess may be wrong
+	int pondering;
+
+	// The keys of the searched game's positions, up to and including the current one, so the search can see when a
+	// line repeats one of them. May be NULL, in which case only repetitions within the search itself are seen. Must
+	// not change while a strategy is running
+	const keyHistory *history;
+} aiContext;
+
+void aiInit(aiContext *ctx, uint64_t seed);
+void aiFree(aiContext *ctx);
+
+// Lets strategies which can split their work use the given pool, or none if it's NULL. The search needs scratch memory
+// for every thread of the pool, so the arena is made big enough for all of them here rather than growing mid-search
+void aiSetPool(aiContext *ctx, threadPool *pool);
+
+// Reseeds the context and forgets everything learned in the previous game
+void aiNewGame(aiContext *ctx, uint64_t seed);
+
+// Sets the clock back to the full --clock time. aiNewGame does this too
+void aiResetClock(aiContext *ctx);
+
+// Takes the time spent on a move off the clock and adds the --increment. Does nothing without a --clock
+void aiChargeClock(aiContext *ctx, int elapsedMs);
+
+// Returns true if the strategy should return as soon as possible. Whatever it returns will be discarded
+int aiShouldStop(aiContext *ctx);
+
+move aiRandomMove(aiContext *ctx, chess *c);
+move aiMinOpponentMoves(aiContext *ctx, chess *c);
+move aiAlphaBeta(aiContext *ctx, chess *c);
+
+struct aiStrategy
+{
+	const char *name;
+	move (*getMove)(aiContext *ctx, chess *c);
+};
+
+// Every strategy, under the name used to pick it on the command line
+extern const aiStrategy aiStrategies[];
+extern const int aiStrategyCount;
+
+// Returns NULL if there is no strategy with that name
+const aiStrategy *aiFindStrategy(const char *name);
+
+// This is the function which determines which strategy the AI will use: the one picked with --strategy, or otherwise
+// the search if it was given a limit and random moves if not. Positions in the opening book are answered straight from
+// the book
+move aiGetMove(aiContext *ctx, chess *c);
+
+// Like aiGetMove, but with the given strategy instead of the configured one
+move aiGetMoveWith(aiContext *ctx, chess *c, const aiStrategy *strategy);
+
+#endif
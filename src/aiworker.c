@@ -0,0 +1,301 @@
+/*
+ * Background AI worker implementation
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include <SFML/System.h>
+
+#include "aiworker.h"
+#include "ai.h"
+#include "zobrist.h"
+#include "keyhistory.h"
+
+typedef enum
+{
+	awIdle,
+	awSearching,
+	awDone,
+} aiWorkerState;
+
+static sfThread *thread = NULL;
+static aiContext ctx;
+static chess *searchGame = NULL;
+
+// The result is written by the worker before it publishes awDone with release ordering, so the main thread sees a
+// complete move as soon as it observes awDone. No locks are needed in either direction
+static move result;
+static atomic_int state;
+static atomic_int stop;
+
+// Only touched by the main thread. engineGame is the game the engine is thinking about, kept so that the bot's own
+// strategy can take over the move if the engine dies before answering
+static uciEngine *engine = NULL;
+static chess *engineGame = NULL;
+
+// While pondering, the worker searches its own copy of the game with the human's predicted move already played. The
+// search only becomes the bot's real one once the human actually plays that move
+static int pondering = 0;
+static chess *ponderGame = NULL;
+static uint64_t ponderKey;
+
+// Set when the human plays the predicted move and the ponder search becomes the real one. The bot's clock only runs
+// from then on, since until then it was the human's turn
+static int ponderHit = 0;
+static sfClock *ponderHitClock = NULL;
+
+// The keys of every position of the game being searched, so that the search can see repetitions from before its root.
+// Rebuilt before every search, and left alone while one runs
+static keyHistory searchKeys;
+
+// The position the current game started from, so that it can be copied along with its moves
+static char *startFen = NULL;
+
+static int aiWorkerUsesEngine()
+{
+	return engine && engineIsAlive(engine);
+}
+
+static void aiWorkerRun(void *userData)
+{
+	(void) userData;
+
+	result = aiGetMove(&ctx, searchGame);
+
+	atomic_store_explicit(&state, awDone, memory_order_release);
+}
+
+void aiWorkerInit(uint64_t seed, threadPool *pool)
+{
+	aiInit(&ctx, seed);
+	ctx.stop = &stop;
+	ctx.history = &searchKeys;
+	aiSetPool(&ctx, pool);
+
+	keyHistoryInit(&searchKeys);
+	ponderHitClock = sfClock_create();
+
+	atomic_init(&state, awIdle);
+	atomic_init(&stop, 0);
+
+	thread = sfThread_create(aiWorkerRun, NULL);
+}
+
+// Only call while the thread isn't running
+static void aiWorkerFreePonderGame()
+{
+	if (ponderGame)
+		chessFree(ponderGame);
+	ponderGame = NULL;
+}
+
+static void aiWorkerLaunch(chess *c)
+{
+	// The previous run has already published its result, but make sure its thread has actually exited
+	sfThread_wait(thread);
+
+	if (ponderGame && ponderGame != c)
+		aiWorkerFreePonderGame();
+
+	if (startFen)
+		keyHistoryReplay(&searchKeys, startFen, c);
+	else
+		keyHistoryReset(&searchKeys, c);
+
+	searchGame = c;
+	ctx.pondering = pondering;
+	atomic_store_explicit(&stop, 0, memory_order_relaxed);
+	atomic_store_explicit(&state, awSearching, memory_order_relaxed);
+
+	sfThread_launch(thread);
+}
+
+void aiWorkerDestroy()
+{
+	aiWorkerCancel();
+
+	sfThread_destroy(thread);
+	thread = NULL;
+
+	free(startFen);
+	startFen = NULL;
+
+	keyHistoryFree(&searchKeys);
+	sfClock_destroy(ponderHitClock);
+	ponderHitClock = NULL;
+
+	aiFree(&ctx);
+}
+
+void aiWorkerSetEngine(uciEngine *e)
+{
+	aiWorkerCancel();
+	engine = e;
+}
+
+void aiWorkerNewGame(const char *fen)
+{
+	aiResetClock(&ctx);
+
+	free(startFen);
+	startFen = (char *) malloc(strlen(fen) + 1);
+	strcpy(startFen, fen);
+
+	if (aiWorkerUsesEngine())
+		engineNewGame(engine, fen);
+	engineGame = NULL;
+}
+
+void aiWorkerStart(chess *c)
+{
+	if (aiWorkerIsBusy())
+		return;
+
+	if (chessGetTerminalState(c) != tsOngoing)
+		return;
+
+	if (aiWorkerUsesEngine())
+	{
+		engineGo(engine, c);
+		if (engineIsBusy(engine))
+		{
+			engineGame = c;
+			return;
+		}
+
+		// The engine died while being asked, so the bot plays this move itself
+	}
+
+	if (pondering)
+	{
+		pondering = 0;
+
+		// The prediction was right, so whatever the ponder search has done or is still doing is the real search now
+		if (zobristHash(chessGetBoard(c)) == ponderKey)
+		{
+			ponderHit = 1;
+			sfClock_restart(ponderHitClock);
+			return;
+		}
+
+		aiWorkerCancel();
+	}
+
+	aiWorkerLaunch(c);
+}
+
+// Replays the game's moves from the start rather than copying its FEN, so that the copy keeps the game's move history.
+// chesslib needs it to end the game on repetitions, and aiWorkerLaunch rebuilds the search's repetition keys from it
+static chess *aiWorkerCopyGame(chess *c)
+{
+	chess *copy = chessCreateFen(startFen);
+	for (moveListNode *n = chessGetMoveHistory(c)->head; n; n = n->next)
+		chessPlayMove(copy, n->move);
+	return copy;
+}
+
+void aiWorkerPonder(chess *c, move predicted)
+{
+	if (aiWorkerUsesEngine() || (aiWorkerIsBusy() && !pondering) || !startFen)
+		return;
+
+	chess *predictedGame = aiWorkerCopyGame(c);
+
+	if (chessPlayMove(predictedGame, predicted) || chessGetTerminalState(predictedGame) != tsOngoing)
+	{
+		chessFree(predictedGame);
+		return;
+	}
+
+	uint64_t key = zobristHash(chessGetBoard(predictedGame));
+	if (pondering && key == ponderKey)
+	{
+		// Already on it
+		chessFree(predictedGame);
+		return;
+	}
+
+	aiWorkerCancel();
+
+	ponderGame = predictedGame;
+	ponderKey = key;
+	pondering = 1;
+
+	aiWorkerLaunch(ponderGame);
+}
+
+void aiWorkerStopPondering()
+{
+	if (pondering)
+		aiWorkerCancel();
+}
+
+int aiWorkerIsBusy()
+{
+	if (engineGame)
+		return 1;
+
+	// A ponder search is only a guess, it never stops the human from doing anything
+	if (pondering)
+		return 0;
+
+	return atomic_load_explicit(&state, memory_order_acquire) != awIdle;
+}
+
+int aiWorkerPoll(move *m)
+{
+	if (engineGame)
+	{
+		if (enginePoll(engine, m))
+		{
+			engineGame = NULL;
+			return 1;
+		}
+
+		if (engineIsBusy(engine))
+			return 0;
+
+		// The engine died or answered with something that isn't a move, so the bot's own strategy plays this one
+		chess *c = engineGame;
+		engineGame = NULL;
+		aiWorkerLaunch(c);
+		return 0;
+	}
+
+	if (pondering || atomic_load_explicit(&state, memory_order_acquire) != awDone)
+		return 0;
+
+	*m = result;
+	atomic_store_explicit(&state, awIdle, memory_order_relaxed);
+
+	// A ponder search doesn't charge the clock itself. Only the time since the human's move counts
+	if (ponderHit)
+	{
+		aiChargeClock(&ctx, sfTime_asMilliseconds(sfClock_getElapsedTime(ponderHitClock)));
+		ponderHit = 0;
+	}
+
+	return 1;
+}
+
+void aiWorkerCancel()
+{
+	if (engine)
+		engineCancel(engine);
+	engineGame = NULL;
+
+	pondering = 0;
+	ponderHit = 0;
+
+	if (atomic_load_explicit(&state, memory_order_acquire) != awIdle)
+	{
+		atomic_store_explicit(&stop, 1, memory_order_relaxed);
+		sfThread_wait(thread);
+
+		atomic_store_explicit(&state, awIdle, memory_order_relaxed);
+	}
+
+	aiWorkerFreePonderGame();
+}
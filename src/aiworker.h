@@ -0,0 +1,52 @@
+/*
+ * Background AI worker declarations
+ */
+
+#ifndef AIWORKER_H
+#define AIWORKER_H
+
+#include <stdint.h>
+
+#include "chesslib/chess.h"
+
+#include "threadpool.h"
+#include "engine.h"
+
+// Runs aiGetMove on a separate thread so that the window keeps responding while the bot thinks. Only one search runs
+// at a time. While a search is running, the game it was given must not be modified or freed by anyone else
+
+// Strategies that can split their work run it on the given pool, which may be NULL
+void aiWorkerInit(uint64_t seed, threadPool *pool);
+void aiWorkerDestroy();
+
+// Hands every search to the given external engine instead, for as long as it keeps running. If it dies in the middle of
+// a move, the bot's own strategy plays that move instead. Pass NULL to go back to the bot's own strategies. The engine
+// is not owned by the worker
+void aiWorkerSetEngine(uciEngine *e);
+
+// Call whenever a new game starts from the given position. Pondering copies games by replaying their moves from it
+void aiWorkerNewGame(const char *fen);
+
+// Starts searching for a move in the given game. Does nothing if a search is already running
+void aiWorkerStart(chess *c);
+
+// Starts searching the position after the human's predicted move while they are still thinking. If they play it,
+// aiWorkerStart carries on with that search instead of starting over, so the reply can come instantly. Otherwise
+// aiWorkerStart throws it away. Does nothing if the bot is already searching for real
+void aiWorkerPonder(chess *c, move predicted);
+
+// Throws away a ponder search whose guess can no longer come true. Does nothing to a real search
+void aiWorkerStopPondering();
+
+// Returns true if a search has been started and its result has not been collected or cancelled yet. While an engine
+// is thinking, the worker thread itself stays idle
+int aiWorkerIsBusy();
+
+// Call this from the main thread every frame. If the search has finished, writes the chosen move to m, makes the
+// worker idle again and returns true. Otherwise returns false without blocking
+int aiWorkerPoll(move *m);
+
+// Asks a running search to stop, waits for it and throws away its result. Call this before modifying the game
+void aiWorkerCancel();
+
+#endif
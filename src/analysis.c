@@ -0,0 +1,161 @@
+/*
+ * Live analysis implementation
+ */
+
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include <SFML/System.h>
+
+#include "analysis.h"
+#include "ai.h"
+
+// Set on the index in latest while that buffer holds results the main thread hasn't read
+#define ANALYSIS_FRESH 4
+
+static sfThread *thread = NULL;
+static aiContext ctx;
+static atomic_int stop;
+static int running = 0;
+
+// Set while the search thread is still working. It clears this itself once it has published its last results, so that
+// the main thread can stop polling when a search ends on its own
+static atomic_int searching;
+
+// A copy of the game being analysed, owned by the analysis
+static chess *game = NULL;
+
+// Triple buffer of results. The publishing thread always has a buffer of its own to write into, and the main thread one
+// to read from. The third is swapped with either of them in a single exchange, which also carries a flag saying whether
+// it holds results the main thread hasn't seen yet. Neither thread ever waits for the other
+static analysisInfo buffers[3];
+static atomic_int latest;
+
+// Only touched by whichever thread is publishing, which is the main thread when no search is running
+static int writing = 0;
+static unsigned int publishedVersion = 0;
+
+// Only touched by the main thread
+static int reading = 1;
+
+static void analysisPublish(analysisInfo *info)
+{
+	info->version = ++publishedVersion;
+	buffers[writing] = *info;
+
+	writing = atomic_exchange(&latest, writing | ANALYSIS_FRESH) & ~ANALYSIS_FRESH;
+}
+
+static void analysisPublishIteration(const searchResult *result, void *userData)
+{
+	(void) userData;
+
+	analysisInfo info;
+	info.depth = result->depth;
+	info.nodes = result->nodes;
+	info.player = chessGetPlayer(game);
+	info.numLines = result->numLines < ANALYSIS_LINES ? result->numLines : ANALYSIS_LINES;
+	for (int i = 0; i < info.numLines; i++)
+		info.lines[i] = result->lines[i];
+
+	analysisPublish(&info);
+}
+
+static void analysisRun(void *userData)
+{
+	(void) userData;
+
+	// No limits, so this only ends when it's told to stop, it runs out of depth or it finds a mate
+	searchLimits limits;
+	limits.depth = 0;
+	limits.nodes = 0;
+	limits.timeMs = 0;
+	limits.multiPv = ANALYSIS_LINES;
+	limits.onIteration = analysisPublishIteration;
+	limits.userData = NULL;
+
+	searchRun(&ctx, game, limits);
+
+	atomic_store(&searching, 0);
+}
+
+void analysisInit(uint64_t seed, threadPool *pool)
+{
+	aiInit(&ctx, seed);
+	aiSetPool(&ctx, pool);
+	ctx.stop = &stop;
+
+	atomic_init(&stop, 0);
+	atomic_init(&latest, 2);
+	atomic_init(&searching, 0);
+
+	thread = sfThread_create(analysisRun, NULL);
+}
+
+void analysisDestroy()
+{
+	analysisStop();
+
+	sfThread_destroy(thread);
+	thread = NULL;
+
+	aiFree(&ctx);
+}
+
+void analysisStart(chess *c)
+{
+	analysisStop();
+
+	char *fen = chessGetFen(c);
+	game = chessCreateFen(fen);
+	free(fen);
+
+	// Clear out the results of the previous position straight away, rather than when the first iteration finishes
+	analysisInfo info;
+	info.depth = 0;
+	info.nodes = 0;
+	info.player = chessGetPlayer(game);
+	info.numLines = 0;
+	analysisPublish(&info);
+
+	if (chessGetTerminalState(game) != tsOngoing)
+		return;
+
+	if (!ctx.tt)
+		ctx.tt = ttCreate(aiConfig.hashSizeMb);
+
+	atomic_store_explicit(&stop, 0, memory_order_relaxed);
+	atomic_store(&searching, 1);
+	sfThread_launch(thread);
+	running = 1;
+}
+
+void analysisStop()
+{
+	if (running)
+	{
+		atomic_store_explicit(&stop, 1, memory_order_relaxed);
+		sfThread_wait(thread);
+		running = 0;
+	}
+
+	if (game)
+		chessFree(game);
+	game = NULL;
+}
+
+int analysisPoll(analysisInfo *info)
+{
+	if (!(atomic_load(&latest) & ANALYSIS_FRESH))
+		return 0;
+
+	reading = atomic_exchange(&latest, reading) & ~ANALYSIS_FRESH;
+	*info = buffers[reading];
+
+	return 1;
+}
+
+int analysisIsBusy()
+{
+	return atomic_load(&searching) || (atomic_load(&latest) & ANALYSIS_FRESH);
+}
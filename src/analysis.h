@@ -0,0 +1,47 @@
+/*
+ * Live analysis declarations
+ */
+
+#ifndef ANALYSIS_H
+#define ANALYSIS_H
+
+#include <stdint.h>
+
+#include "chesslib/chess.h"
+
+#include "search.h"
+#include "threadpool.h"
+
+// How many of the best moves are analysed
+#define ANALYSIS_LINES 3
+
+// What the analysis has found so far about the position it was last started on
+typedef struct
+{
+	int depth; // 0 until the first iteration finishes
+	unsigned long long nodes;
+	pieceColor player; // The player to move, who the scores are for
+	int numLines;
+	searchLine lines[ANALYSIS_LINES];
+	unsigned int version; // Goes up every time new results are published
+} analysisInfo;
+
+// Analyses positions on a separate thread, searching deeper and deeper until it is stopped or restarted. Results are
+// handed to the main thread through a triple buffer, so neither the search nor the main thread ever waits for the other
+void analysisInit(uint64_t seed, threadPool *pool);
+void analysisDestroy();
+
+// Stops any analysis in progress and starts analysing the current position of c. The game isn't read again afterwards,
+// so it can be changed straight away
+void analysisStart(chess *c);
+void analysisStop();
+
+// Copies the latest results to info if they have changed since the last call, and returns whether they had. Only call
+// this from one thread
+int analysisPoll(analysisInfo *info);
+
+// Returns true while the search is still running, or while it has results analysisPoll hasn't picked up yet. Once this
+// is false, nothing changes until the analysis is started again
+int analysisIsBusy();
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * Arena allocator implementation
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "arena.h"
+
+struct arenaBlock
+{
+	arenaBlock *next;
+	size_t capacity;
+	size_t used;
+};
+
+static arenaBlock *arenaBlockCreate(size_t capacity)
+{
+	// Leave room to align the start of the data
+	arenaBlock *block = (arenaBlock *) malloc(sizeof(arenaBlock) + capacity + ARENA_ALIGNMENT);
+	if (!block)
+	{
+		fprintf(stderr, "ERROR: Out of memory allocating a %zu byte arena block\n", capacity);
+		exit(1);
+	}
+
+	block->next = NULL;
+	block->capacity = capacity;
+	block->used = 0;
+	return block;
+}
+
+static void *arenaBlockAlloc(arenaBlock *block, size_t size)
+{
+	uintptr_t base = ((uintptr_t) (block + 1) + ARENA_ALIGNMENT - 1) & ~(uintptr_t) (ARENA_ALIGNMENT - 1);
+	size_t offset = (block->used + ARENA_ALIGNMENT - 1) & ~(size_t) (ARENA_ALIGNMENT - 1);
+
+	if (offset + size > block->capacity)
+		return NULL;
+
+	block->used = offset + size;
+	return (void *) (base + offset);
+}
+
+void arenaInit(arena *a, size_t size)
+{
+	a->blockSize = size;
+	a->first = arenaBlockCreate(size);
+	a->current = a->first;
+	a->growths = 0;
+}
+
+void arenaFree(arena *a)
+{
+	arenaBlock *block = a->first;
+	while (block)
+	{
+		arenaBlock *next = block->next;
+		free(block);
+		block = next;
+	}
+
+	a->first = NULL;
+	a->current = NULL;
+}
+
+void arenaReset(arena *a)
+{
+	for (arenaBlock *block = a->first; block; block = block->next)
+		block->used = 0;
+
+	a->current = a->first;
+}
+
+void *arenaAlloc(arena *a, size_t size)
+{
+	// Use up the blocks we already have before asking the heap for another one
+	while (1)
+	{
+		void *p = arenaBlockAlloc(a->current, size);
+		if (p)
+			return p;
+
+		if (!a->current->next)
+			break;
+
+		a->current = a->current->next;
+	}
+
+	size_t capacity = size > a->blockSize ? size : a->blockSize;
+	a->current->next = arenaBlockCreate(capacity);
+	a->current = a->current->next;
+	a->growths++;
+
+	return arenaBlockAlloc(a->current, size);
+}
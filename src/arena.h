@@ -0,0 +1,38 @@
+/*
+ * Arena allocator declarations
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Every allocation starts on a cache line
+#define ARENA_ALIGNMENT 64
+
+// A bump allocator. Allocations are never freed one by one, the whole arena is reset at once instead. Memory is kept
+// across resets, so once the arena has grown to fit a search, later searches never need another block
+
+typedef struct arenaBlock arenaBlock;
+
+typedef struct
+{
+	arenaBlock *first;
+	arenaBlock *current;
+	size_t blockSize;
+
+	// How many blocks the arena has had to add after the first one, each of them a heap allocation. Stays at 0 as long
+	// as everything fits in the size given to arenaInit
+	unsigned long long growths;
+} arena;
+
+void arenaInit(arena *a, size_t size);
+void arenaFree(arena *a);
+
+// Makes all of the memory available again. Every pointer handed out before is invalid afterwards
+void arenaReset(arena *a);
+
+// Returns uninitialized memory aligned to a cache line, so that buffers handed to different threads never share one
+void *arenaAlloc(arena *a, size_t size);
+
+#endif
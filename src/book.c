@@ -0,0 +1,168 @@
+/*
+ * Opening book implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "book.h"
+#include "mappedfile.h"
+#include "movebuffer.h"
+#include "zobrist.h"
+
+// Every entry is 16 bytes, big endian: 8 byte key, 2 byte move, 2 byte weight, 4 byte learn data. Entries are sorted by
+// key, so all the moves for one position are next to each other
+#define BOOK_ENTRY_SIZE 16
+
+// Only this many moves from one position are considered. Real books have far fewer
+#define BOOK_MAX_MOVES 64
+
+struct openingBook
+{
+	mappedFile file;
+	size_t numEntries;
+};
+
+static uint64_t readBigEndian(const uint8_t *p, int bytes)
+{
+	uint64_t value = 0;
+	for (int i = 0; i < bytes; i++)
+		value = (value << 8) | p[i];
+	return value;
+}
+
+static uint64_t bookEntryKey(openingBook *book, size_t i)
+{
+	return readBigEndian(book->file.data + i * BOOK_ENTRY_SIZE, 8);
+}
+
+openingBook *bookOpen(const char *path)
+{
+	openingBook *book = (openingBook *) malloc(sizeof(openingBook));
+
+	if (!mappedFileOpen(&book->file, path))
+	{
+		fprintf(stderr, "ERROR: Unable to open opening book %s\n", path);
+		free(book);
+		return NULL;
+	}
+
+	if (book->file.size % BOOK_ENTRY_SIZE != 0)
+	{
+		fprintf(stderr, "ERROR: %s is not a Polyglot opening book\n", path);
+		mappedFileClose(&book->file);
+		free(book);
+		return NULL;
+	}
+
+	book->numEntries = book->file.size / BOOK_ENTRY_SIZE;
+	return book;
+}
+
+void bookClose(openingBook *book)
+{
+	if (!book)
+		return;
+
+	mappedFileClose(&book->file);
+	free(book);
+}
+
+size_t bookGetSize(openingBook *book)
+{
+	return book->numEntries;
+}
+
+// Converts a Polyglot move to the legal move it stands for, or returns false if it isn't legal here
+static int bookDecodeMove(board *b, uint16_t encoded, move *m)
+{
+	sq to = {(encoded & 7) + 1, ((encoded >> 3) & 7) + 1};
+	sq from = {((encoded >> 6) & 7) + 1, ((encoded >> 9) & 7) + 1};
+
+	const pieceType promotions[8] = {ptEmpty, ptKnight, ptBishop, ptRook, ptQueen, ptEmpty, ptEmpty, ptEmpty};
+	pieceType promotion = promotions[(encoded >> 12) & 7];
+
+	// Polyglot writes castling as the king capturing its own rook
+	if (pieceGetType(boardGetPiece(b, from)) == ptKing && from.file == 5)
+	{
+		if (to.file == 8 && pieceGetType(boardGetPiece(b, to)) == ptRook)
+			to.file = 7;
+		else if (to.file == 1 && pieceGetType(boardGetPiece(b, to)) == ptRook)
+			to.file = 3;
+	}
+
+	// Books can have errors and key collisions, so only ever play moves that are legal here
+	moveBuffer legal;
+	moveBufferGenerate(&legal, b);
+	for (int i = 0; i < legal.size; i++)
+	{
+		move candidate = legal.moves[i];
+		if (sqEq(candidate.from, from) && sqEq(candidate.to, to) && candidate.promotion == promotion)
+		{
+			*m = candidate;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+int bookProbe(openingBook *book, board *b, rng *r, move *m)
+{
+	uint64_t key = zobristHash(b);
+
+	// Binary search for the first entry with this key
+	size_t low = 0;
+	size_t high = book->numEntries;
+	while (low < high)
+	{
+		size_t mid = low + (high - low) / 2;
+		if (bookEntryKey(book, mid) < key)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+
+	move moves[BOOK_MAX_MOVES];
+	int weights[BOOK_MAX_MOVES];
+	int count = 0;
+	int totalWeight = 0;
+
+	for (size_t i = low; i < book->numEntries && count < BOOK_MAX_MOVES && bookEntryKey(book, i) == key; i++)
+	{
+		const uint8_t *entry = book->file.data + i * BOOK_ENTRY_SIZE;
+		uint16_t encoded = (uint16_t) readBigEndian(entry + 8, 2);
+		int weight = (int) readBigEndian(entry + 10, 2);
+
+		if (!bookDecodeMove(b, encoded, &moves[count]))
+			continue;
+
+		weights[count] = weight;
+		totalWeight += weight;
+		count++;
+	}
+
+	if (count == 0)
+		return 0;
+
+	// If every move has a weight of 0, treat them all the same
+	if (totalWeight == 0)
+	{
+		*m = moves[rngInt(r, count)];
+		return 1;
+	}
+
+	int pick = rngInt(r, totalWeight);
+	for (int i = 0; i < count; i++)
+	{
+		pick -= weights[i];
+		if (pick < 0)
+		{
+			*m = moves[i];
+			return 1;
+		}
+	}
+
+	*m = moves[count - 1];
+	return 1;
+}
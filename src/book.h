@@ -0,0 +1,27 @@
+/*
+ * Opening book declarations
+ */
+
+#ifndef BOOK_H
+#define BOOK_H
+
+#include "chesslib/board.h"
+
+#include "rng.h"
+
+// A Polyglot .bin opening book. The file is memory mapped rather than read in, so opening even a huge book is instant
+// and only the pages a lookup touches are ever loaded
+typedef struct openingBook openingBook;
+
+// Returns NULL if the file can't be mapped or isn't a whole number of book entries
+openingBook *bookOpen(const char *path);
+void bookClose(openingBook *book);
+
+// Returns the number of entries in the book, one per move
+size_t bookGetSize(openingBook *book);
+
+// Looks up the position and picks one of its book moves at random, weighted by the weights stored in the book. Returns
+// false if the position isn't in the book, in which case m is left alone
+int bookProbe(openingBook *book, board *b, rng *r, move *m);
+
+#endif
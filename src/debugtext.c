@@ -0,0 +1,86 @@
+/*
+ * Debug text implementation
+ */
+
+#include <ctype.h>
+
+#include "debugtext.h"
+
+// Each glyph is 5 rows of 3 pixels, top row first. In octal, every digit is one row with the left pixel as the high bit
+static unsigned int getGlyph(char c)
+{
+	if (c >= '0' && c <= '9')
+	{
+		const unsigned int digits[10] =
+		{
+			075557, 026227, 071747, 071717, 055711, 074717, 074757, 071111, 075757, 075717
+		};
+		return digits[c - '0'];
+	}
+
+	c = toupper((unsigned char) c);
+	if (c >= 'A' && c <= 'Z')
+	{
+		const unsigned int letters[26] =
+		{
+			025755, 065656, 034443, 065556, 074647, 074644, 034553, 055755, 072227, 011152, 055655, 044447, 057755,
+			065555, 025552, 065644, 025563, 065655, 034216, 072222, 055557, 055552, 055775, 055255, 055222, 071247
+		};
+		return letters[c - 'A'];
+	}
+
+	switch (c)
+	{
+		case '.':
+			return 000002;
+		case ':':
+			return 002020;
+		case '-':
+			return 000700;
+		case '+':
+			return 002720;
+		case '/':
+			return 011244;
+		default:
+			return 0;
+	}
+}
+
+void debugTextAppend(sfVertexArray *va, const char *text, sfVector2f position, float pixelSize, sfColor color)
+{
+	float x = position.x;
+	float y = position.y;
+
+	for (const char *c = text; *c; c++)
+	{
+		if (*c == '\n')
+		{
+			x = position.x;
+			y += DEBUG_TEXT_LINE_HEIGHT * pixelSize;
+			continue;
+		}
+
+		unsigned int glyph = getGlyph(*c);
+		for (int row = 0; row < DEBUG_TEXT_GLYPH_HEIGHT; row++)
+		{
+			unsigned int bits = (glyph >> (3 * (DEBUG_TEXT_GLYPH_HEIGHT - 1 - row))) & 07;
+			for (int col = 0; col < DEBUG_TEXT_GLYPH_WIDTH; col++)
+			{
+				if (!(bits & (04 >> col)))
+					continue;
+
+				float left = x + col * pixelSize;
+				float top = y + row * pixelSize;
+				sfVector2f corners[6] =
+				{
+					{left, top}, {left + pixelSize, top}, {left + pixelSize, top + pixelSize},
+					{left, top}, {left + pixelSize, top + pixelSize}, {left, top + pixelSize}
+				};
+				for (int i = 0; i < 6; i++)
+					sfVertexArray_append(va, (sfVertex) {corners[i], color, {0.0f, 0.0f}});
+			}
+		}
+
+		x += DEBUG_TEXT_ADVANCE * pixelSize;
+	}
+}
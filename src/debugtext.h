@@ -0,0 +1,24 @@
+/*
+ * Debug text declarations
+ */
+
+#ifndef DEBUGTEXT_H
+#define DEBUGTEXT_H
+
+#include <SFML/Graphics.h>
+
+// A tiny built-in 3x5 pixel font, so that debug overlays can show text without shipping a font file. It only has
+// digits, upper case letters (lower case is drawn as upper case) and a little punctuation
+
+#define DEBUG_TEXT_GLYPH_WIDTH 3
+#define DEBUG_TEXT_GLYPH_HEIGHT 5
+
+// Horizontal distance from one character to the next, and vertical distance from one line to the next, in font pixels
+#define DEBUG_TEXT_ADVANCE 4
+#define DEBUG_TEXT_LINE_HEIGHT 7
+
+// Appends the text to a vertex array of triangles, with its top left corner at position. Every font pixel is drawn as
+// a square pixelSize wide. Newlines start a new line
+void debugTextAppend(sfVertexArray *va, const char *text, sfVector2f position, float pixelSize, sfColor color);
+
+#endif
@@ -0,0 +1,476 @@
+/*
+ * External UCI engine implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#endif
+
+#include <SFML/System.h>
+
+#include "engine.h"
+#include "ai.h"
+#include "notation.h"
+
+// Longest line read from the engine. Longer lines (like a very long pv) are cut off, which is fine for the lines that
+// matter here
+#define ENGINE_BUFFER_SIZE 4096
+
+// How long the engine thinks when the bot has no --depth, --nodes or --movetime limit
+#define ENGINE_DEFAULT_MOVETIME_MS 1000
+
+// Room for everything in a position and go command other than the FEN and the moves
+#define ENGINE_COMMAND_EXTRA_LENGTH 192
+
+// How long the engine gets to quit on its own before it's killed
+#define ENGINE_QUIT_TIMEOUT_MS 1000
+
+struct uciEngine
+{
+#ifdef _WIN32
+	HANDLE process;
+	HANDLE input; // The engine's stdin
+	HANDLE output; // The engine's stdout
+#else
+	pid_t pid;
+	int input;
+	int output;
+#endif
+
+	char buffer[ENGINE_BUFFER_SIZE];
+	size_t length;
+
+	// Commands the engine's pipe hasn't taken yet. They are written as it makes room, so an engine which stops reading
+	// can never block the caller
+	char *pending;
+	size_t pendingLength;
+	size_t pendingCapacity;
+
+	// The engine's own clock with --clock, and how long it has been thinking about the current move
+	int clockMs;
+	sfClock *moveClock;
+
+	char *startFen;
+	int alive;
+	int searching;
+
+	// Cancelled searches still end with a bestmove, which has to be skipped before the next real answer
+	int discards;
+};
+
+static void engineDied(uciEngine *e)
+{
+	if (e->alive)
+		fprintf(stderr, "ERROR: The engine exited\n");
+
+	e->alive = 0;
+	e->searching = 0;
+	e->discards = 0;
+}
+
+// Writes as much of the pending commands as the pipe will take without waiting
+static void engineFlush(uciEngine *e)
+{
+	size_t written = 0;
+
+	while (e->alive && written < e->pendingLength)
+	{
+#ifdef _WIN32
+		DWORD count;
+		if (!WriteFile(e->input, e->pending + written, (DWORD) (e->pendingLength - written), &count, NULL))
+		{
+			engineDied(e);
+			break;
+		}
+		if (count == 0)
+			break;
+#else
+		ssize_t count = write(e->input, e->pending + written, e->pendingLength - written);
+		if (count < 0)
+		{
+			if (errno != EAGAIN && errno != EWOULDBLOCK)
+				engineDied(e);
+			break;
+		}
+#endif
+		written += count;
+	}
+
+	if (!e->alive)
+		written = e->pendingLength;
+
+	e->pendingLength -= written;
+	memmove(e->pending, e->pending + written, e->pendingLength);
+}
+
+static void engineSend(uciEngine *e, const char *command)
+{
+	if (!e->alive)
+		return;
+
+	size_t length = strlen(command);
+	if (e->pendingLength + length > e->pendingCapacity)
+	{
+		e->pendingCapacity = (e->pendingLength + length) * 2;
+		e->pending = (char *) realloc(e->pending, e->pendingCapacity);
+	}
+
+	memcpy(e->pending + e->pendingLength, command, length);
+	e->pendingLength += length;
+
+	engineFlush(e);
+}
+
+// Reads as much as is available without waiting. Returns false if the engine has gone away
+static int engineRead(uciEngine *e)
+{
+	if (e->length == ENGINE_BUFFER_SIZE - 1)
+	{
+		// A single line filled the buffer. Drop it, the part that matters always comes first
+		e->length = 0;
+	}
+
+#ifdef _WIN32
+	DWORD available;
+	if (!PeekNamedPipe(e->output, NULL, 0, NULL, &available, NULL))
+		return 0;
+	if (available == 0)
+		return 1;
+
+	DWORD space = (DWORD) (ENGINE_BUFFER_SIZE - 1 - e->length);
+	DWORD count;
+	if (!ReadFile(e->output, e->buffer + e->length, available < space ? available : space, &count, NULL))
+		return 0;
+#else
+	ssize_t count = read(e->output, e->buffer + e->length, ENGINE_BUFFER_SIZE - 1 - e->length);
+	if (count == 0)
+		return 0;
+	if (count < 0)
+		return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+
+	e->length += count;
+	e->buffer[e->length] = '\0';
+	return 1;
+}
+
+uciEngine *engineStart(const char *path)
+{
+	uciEngine *e = (uciEngine *) malloc(sizeof(uciEngine));
+
+#ifdef _WIN32
+	SECURITY_ATTRIBUTES attributes = {sizeof(SECURITY_ATTRIBUTES), NULL, TRUE};
+
+	HANDLE childInput, childOutput;
+	if (!CreatePipe(&childInput, &e->input, &attributes, 0))
+	{
+		fprintf(stderr, "ERROR: Unable to create a pipe for the engine\n");
+		free(e);
+		return NULL;
+	}
+	if (!CreatePipe(&e->output, &childOutput, &attributes, 0))
+	{
+		fprintf(stderr, "ERROR: Unable to create a pipe for the engine\n");
+		CloseHandle(childInput);
+		CloseHandle(e->input);
+		free(e);
+		return NULL;
+	}
+
+	// Only the child's ends are inherited
+	SetHandleInformation(e->input, HANDLE_FLAG_INHERIT, 0);
+	SetHandleInformation(e->output, HANDLE_FLAG_INHERIT, 0);
+
+	STARTUPINFOA startup;
+	memset(&startup, 0, sizeof(startup));
+	startup.cb = sizeof(startup);
+	startup.dwFlags = STARTF_USESTDHANDLES;
+	startup.hStdInput = childInput;
+	startup.hStdOutput = childOutput;
+	startup.hStdError = GetStdHandle(STD_ERROR_HANDLE);
+
+	char *commandLine = (char *) malloc(strlen(path) + 3);
+	sprintf(commandLine, "\"%s\"", path);
+
+	PROCESS_INFORMATION info;
+	BOOL started = CreateProcessA(NULL, commandLine, NULL, NULL, TRUE, CREATE_NO_WINDOW, NULL, NULL, &startup, &info);
+
+	free(commandLine);
+	CloseHandle(childInput);
+	CloseHandle(childOutput);
+
+	if (!started)
+	{
+		fprintf(stderr, "ERROR: Unable to start engine %s\n", path);
+		CloseHandle(e->input);
+		CloseHandle(e->output);
+		free(e);
+		return NULL;
+	}
+
+	CloseHandle(info.hThread);
+	e->process = info.hProcess;
+
+	// Anonymous pipes are byte mode pipes, which can be switched to non-blocking writes
+	DWORD mode = PIPE_NOWAIT;
+	SetNamedPipeHandleState(e->input, &mode, NULL, NULL);
+#else
+	int toEngine[2], fromEngine[2];
+	if (pipe(toEngine) != 0)
+	{
+		fprintf(stderr, "ERROR: Unable to create a pipe for the engine\n");
+		free(e);
+		return NULL;
+	}
+	if (pipe(fromEngine) != 0)
+	{
+		fprintf(stderr, "ERROR: Unable to create a pipe for the engine\n");
+		close(toEngine[0]);
+		close(toEngine[1]);
+		free(e);
+		return NULL;
+	}
+
+	e->pid = fork();
+	if (e->pid < 0)
+	{
+		fprintf(stderr, "ERROR: Unable to start engine %s\n", path);
+		close(toEngine[0]);
+		close(toEngine[1]);
+		close(fromEngine[0]);
+		close(fromEngine[1]);
+		free(e);
+		return NULL;
+	}
+
+	if (e->pid == 0)
+	{
+		dup2(toEngine[0], STDIN_FILENO);
+		dup2(fromEngine[1], STDOUT_FILENO);
+		close(toEngine[0]);
+		close(toEngine[1]);
+		close(fromEngine[0]);
+		close(fromEngine[1]);
+
+		execl(path, path, (char *) NULL);
+
+		// The parent finds out when the pipe closes
+		fprintf(stderr, "ERROR: Unable to start engine %s\n", path);
+		_exit(127);
+	}
+
+	close(toEngine[0]);
+	close(fromEngine[1]);
+	e->input = toEngine[1];
+	e->output = fromEngine[0];
+
+	fcntl(e->input, F_SETFL, fcntl(e->input, F_GETFL) | O_NONBLOCK);
+	fcntl(e->output, F_SETFL, fcntl(e->output, F_GETFL) | O_NONBLOCK);
+
+	// A write to an engine which has crashed should fail, not kill this process
+	signal(SIGPIPE, SIG_IGN);
+#endif
+
+	e->length = 0;
+	e->buffer[0] = '\0';
+	e->pending = NULL;
+	e->pendingLength = 0;
+	e->pendingCapacity = 0;
+	e->clockMs = aiConfig.clockMs;
+	e->moveClock = sfClock_create();
+	e->startFen = NULL;
+	e->alive = 1;
+	e->searching = 0;
+	e->discards = 0;
+
+	// The engine reads its commands in order, so there's no need to wait for uciok before sending more
+	engineSend(e, "uci\nisready\n");
+
+	return e;
+}
+
+void engineStop(uciEngine *e)
+{
+	if (!e)
+		return;
+
+	// Whatever doesn't fit in the pipe now is dropped, and the engine is killed if it doesn't quit in time
+	engineSend(e, "quit\n");
+
+#ifdef _WIN32
+	CloseHandle(e->input);
+	CloseHandle(e->output);
+
+	if (WaitForSingleObject(e->process, ENGINE_QUIT_TIMEOUT_MS) != WAIT_OBJECT_0)
+		TerminateProcess(e->process, 1);
+	CloseHandle(e->process);
+#else
+	close(e->input);
+	close(e->output);
+
+	sfClock *clock = sfClock_create();
+	while (waitpid(e->pid, NULL, WNOHANG) == 0)
+	{
+		if (sfTime_asMilliseconds(sfClock_getElapsedTime(clock)) >= ENGINE_QUIT_TIMEOUT_MS)
+		{
+			kill(e->pid, SIGKILL);
+			waitpid(e->pid, NULL, 0);
+			break;
+		}
+		sfSleep(sfMilliseconds(10));
+	}
+	sfClock_destroy(clock);
+#endif
+
+	sfClock_destroy(e->moveClock);
+	free(e->pending);
+	free(e->startFen);
+	free(e);
+}
+
+// Takes the time the engine spent on its move off its clock, like the bot's own search does
+static void engineChargeClock(uciEngine *e)
+{
+	if (!aiConfig.clockMs)
+		return;
+
+	e->clockMs += aiConfig.incrementMs - sfTime_asMilliseconds(sfClock_getElapsedTime(e->moveClock));
+	if (e->clockMs < 0)
+		e->clockMs = 0;
+}
+
+int engineIsAlive(uciEngine *e)
+{
+	return e->alive;
+}
+
+void engineNewGame(uciEngine *e, const char *fen)
+{
+	engineCancel(e);
+
+	free(e->startFen);
+	e->startFen = (char *) malloc(strlen(fen) + 1);
+	strcpy(e->startFen, fen);
+
+	e->clockMs = aiConfig.clockMs;
+
+	engineSend(e, "ucinewgame\nisready\n");
+}
+
+void engineGo(uciEngine *e, chess *c)
+{
+	if (!e->alive || e->searching || !e->startFen)
+		return;
+
+	// Send the whole game rather than just the current position, so the engine knows about repetitions
+	moveList *history = chessGetMoveHistory(c);
+	char *command = (char *) malloc(strlen(e->startFen) + history->size * NOTATION_UCI_LENGTH + ENGINE_COMMAND_EXTRA_LENGTH);
+
+	int length = sprintf(command, "position fen %s", e->startFen);
+	if (history->size)
+		length += sprintf(command + length, " moves");
+	for (moveListNode *n = history->head; n; n = n->next)
+	{
+		command[length++] = ' ';
+		notationMoveToUci(n->move, command + length);
+		length += strlen(command + length);
+	}
+
+	int moveTimeMs = aiConfig.moveTimeMs;
+	if (!moveTimeMs && !aiConfig.searchDepth && !aiConfig.searchNodes && !aiConfig.clockMs)
+		moveTimeMs = ENGINE_DEFAULT_MOVETIME_MS;
+
+	length += sprintf(command + length, "\ngo");
+	if (aiConfig.searchDepth)
+		length += sprintf(command + length, " depth %d", aiConfig.searchDepth);
+	if (aiConfig.searchNodes)
+		length += sprintf(command + length, " nodes %llu", aiConfig.searchNodes);
+	if (moveTimeMs)
+		length += sprintf(command + length, " movetime %d", moveTimeMs);
+
+	// Only the engine's clock is kept, so it is sent for both sides. The engine only looks at its own
+	if (aiConfig.clockMs)
+		length += sprintf(command + length, " wtime %d btime %d winc %d binc %d", e->clockMs, e->clockMs,
+				aiConfig.incrementMs, aiConfig.incrementMs);
+	sprintf(command + length, "\n");
+
+	engineSend(e, command);
+	free(command);
+
+	sfClock_restart(e->moveClock);
+
+	e->searching = e->alive;
+}
+
+int engineIsBusy(uciEngine *e)
+{
+	return e->searching;
+}
+
+int enginePoll(uciEngine *e, move *m)
+{
+	if (!e->alive)
+		return 0;
+
+	engineFlush(e);
+
+	if (!engineRead(e))
+	{
+		engineDied(e);
+		return 0;
+	}
+
+	int found = 0;
+	char *line = e->buffer;
+	char *end;
+
+	// Handle complete lines only, up to the first move that is wanted. Anything after it waits for the next poll
+	while (!found && (end = strchr(line, '\n')))
+	{
+		*end = '\0';
+
+		if (strncmp(line, "bestmove ", 9) == 0)
+		{
+			if (e->discards)
+			{
+				e->discards--;
+			}
+			else if (e->searching)
+			{
+				e->searching = 0;
+				engineChargeClock(e);
+				if (notationMoveFromUci(line + 9, m))
+					found = 1;
+				else
+					fprintf(stderr, "ERROR: The engine sent an invalid move: %s\n", line + 9);
+			}
+		}
+
+		line = end + 1;
+	}
+
+	e->length -= line - e->buffer;
+	memmove(e->buffer, line, e->length + 1);
+
+	return found;
+}
+
+void engineCancel(uciEngine *e)
+{
+	if (!e->searching)
+		return;
+
+	engineSend(e, "stop\n");
+	e->searching = 0;
+	e->discards++;
+}
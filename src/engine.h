@@ -0,0 +1,40 @@
+/*
+ * External UCI engine declarations
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include "chesslib/chess.h"
+
+// Another UCI engine running as a child process, talked to over pipes. Nothing here ever blocks waiting for the
+// engine: commands are written as its pipe takes them, and its answers are picked up by calling enginePoll every frame
+typedef struct uciEngine uciEngine;
+
+// Starts the engine at the given path and sends it the UCI handshake. Returns NULL if the process can't be started
+uciEngine *engineStart(const char *path);
+
+// Asks the engine to quit, and kills it if it doesn't do so in time
+void engineStop(uciEngine *e);
+
+// Returns false once the engine has exited or its pipes have broken
+int engineIsAlive(uciEngine *e);
+
+// Tells the engine a new game is starting from the given position. The engine is kept running between games
+void engineNewGame(uciEngine *e, const char *fen);
+
+// Sends the game so far and asks the engine for a move. With --clock, the engine plays on its own clock, which is sent
+// as wtime/btime and winc/binc. Does nothing if the engine is already thinking
+void engineGo(uciEngine *e, chess *c);
+
+// Returns true if the engine has been asked for a move which hasn't been collected or cancelled yet
+int engineIsBusy(uciEngine *e);
+
+// Writes any commands still waiting for the pipe, and reads whatever the engine has written so far, all without
+// blocking. If it has answered, writes its move to m and returns true
+int enginePoll(uciEngine *e, move *m);
+
+// Tells a thinking engine to stop. The move it still sends back is thrown away
+void engineCancel(uciEngine *e);
+
+#endif
@@ -0,0 +1,173 @@
+/*
+ * Static evaluation implementation
+ */
+
+#include "eval.h"
+
+// Piece-square tables, written from white's point of view with rank 8 at the top, like a board diagram. These are the
+// "simplified evaluation function" tables by Tomasz Michniewski
+
+static const int pstPawn[64] =
+{
+	  0,   0,   0,   0,   0,   0,   0,   0,
+	 50,  50,  50,  50,  50,  50,  50,  50,
+	 10,  10,  20,  30,  30,  20,  10,  10,
+	  5,   5,  10,  25,  25,  10,   5,   5,
+	  0,   0,   0,  20,  20,   0,   0,   0,
+	  5,  -5, -10,   0,   0, -10,  -5,   5,
+	  5,  10,  10, -20, -20,  10,  10,   5,
+	  0,   0,   0,   0,   0,   0,   0,   0,
+};
+
+static const int pstKnight[64] =
+{
+	-50, -40, -30, -30, -30, -30, -40, -50,
+	-40, -20,   0,   0,   0,   0, -20, -40,
+	-30,   0,  10,  15,  15,  10,   0, -30,
+	-30,   5,  15,  20,  20,  15,   5, -30,
+	-30,   0,  15,  20,  20,  15,   0, -30,
+	-30,   5,  10,  15,  15,  10,   5, -30,
+	-40, -20,   0,   5,   5,   0, -20, -40,
+	-50, -40, -30, -30, -30, -30, -40, -50,
+};
+
+static const int pstBishop[64] =
+{
+	-20, -10, -10, -10, -10, -10, -10, -20,
+	-10,   0,   0,   0,   0,   0,   0, -10,
+	-10,   0,   5,  10,  10,   5,   0, -10,
+	-10,   5,   5,  10,  10,   5,   5, -10,
+	-10,   0,  10,  10,  10,  10,   0, -10,
+	-10,  10,  10,  10,  10,  10,  10, -10,
+	-10,   5,   0,   0,   0,   0,   5, -10,
+	-20, -10, -10, -10, -10, -10, -10, -20,
+};
+
+static const int pstRook[64] =
+{
+	  0,   0,   0,   0,   0,   0,   0,   0,
+	  5,  10,  10,  10,  10,  10,  10,   5,
+	 -5,   0,   0,   0,   0,   0,   0,  -5,
+	 -5,   0,   0,   0,   0,   0,   0,  -5,
+	 -5,   0,   0,   0,   0,   0,   0,  -5,
+	 -5,   0,   0,   0,   0,   0,   0,  -5,
+	 -5,   0,   0,   0,   0,   0,   0,  -5,
+	  0,   0,   0,   5,   5,   0,   0,   0,
+};
+
+static const int pstQueen[64] =
+{
+	-20, -10, -10,  -5,  -5, -10, -10, -20,
+	-10,   0,   0,   0,   0,   0,   0, -10,
+	-10,   0,   5,   5,   5,   5,   0, -10,
+	 -5,   0,   5,   5,   5,   5,   0,  -5,
+	  0,   0,   5,   5,   5,   5,   0,  -5,
+	-10,   5,   5,   5,   5,   5,   0, -10,
+	-10,   0,   5,   0,   0,   0,   0, -10,
+	-20, -10, -10,  -5,  -5, -10, -10, -20,
+};
+
+static const int pstKingMiddlegame[64] =
+{
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-30, -40, -40, -50, -50, -40, -40, -30,
+	-20, -30, -30, -40, -40, -30, -30, -20,
+	-10, -20, -20, -20, -20, -20, -20, -10,
+	 20,  20,   0,   0,   0,   0,  20,  20,
+	 20,  30,  10,   0,   0,  10,  30,  20,
+};
+
+static const int pstKingEndgame[64] =
+{
+	-50, -40, -30, -20, -20, -30, -40, -50,
+	-30, -20, -10,   0,   0, -10, -20, -30,
+	-30, -10,  20,  30,  30,  20, -10, -30,
+	-30, -10,  30,  40,  40,  30, -10, -30,
+	-30, -10,  30,  40,  40,  30, -10, -30,
+	-30, -10,  20,  30,  30,  20, -10, -30,
+	-30, -30,   0,   0,   0,   0, -30, -30,
+	-50, -30, -30, -30, -30, -30, -30, -50,
+};
+
+int evalPieceValue(pieceType pt)
+{
+	switch (pt)
+	{
+		case ptPawn:
+			return 100;
+		case ptKnight:
+			return 320;
+		case ptBishop:
+			return 330;
+		case ptRook:
+			return 500;
+		case ptQueen:
+			return 900;
+		case ptKing:
+			return 20000;
+		default:
+			return 0;
+	}
+}
+
+int evalBoard(board *b)
+{
+	int score[2] = {0, 0};
+	int nonPawnMaterial = 0;
+	int kingIndex[2] = {0, 0};
+
+	for (int rank = 1; rank <= 8; rank++)
+	{
+		for (int file = 1; file <= 8; file++)
+		{
+			piece p = boardGetPiece(b, (sq) {file, rank});
+			if (!p)
+				continue;
+
+			pieceType pt = pieceGetType(p);
+			int color = pieceGetColor(p) == pcWhite ? 0 : 1;
+
+			// Flip the table vertically for black
+			int index = color == 0 ? 8 * (8 - rank) + (file - 1) : 8 * (rank - 1) + (file - 1);
+
+			switch (pt)
+			{
+				case ptPawn:
+					score[color] += pstPawn[index];
+					break;
+				case ptKnight:
+					score[color] += pstKnight[index];
+					break;
+				case ptBishop:
+					score[color] += pstBishop[index];
+					break;
+				case ptRook:
+					score[color] += pstRook[index];
+					break;
+				case ptQueen:
+					score[color] += pstQueen[index];
+					break;
+				case ptKing:
+					kingIndex[color] = index;
+					break;
+				default:
+					break;
+			}
+
+			if (pt != ptKing)
+				score[color] += evalPieceValue(pt);
+			if (pt != ptKing && pt != ptPawn)
+				nonPawnMaterial += evalPieceValue(pt);
+		}
+	}
+
+	// Once the queens and most of the minor pieces are gone, the king should head for the center
+	const int *kingTable = nonPawnMaterial <= 1300 ? pstKingEndgame : pstKingMiddlegame;
+	score[0] += kingTable[kingIndex[0]];
+	score[1] += kingTable[kingIndex[1]];
+
+	int eval = score[0] - score[1];
+	return b->currentPlayer == pcWhite ? eval : -eval;
+}
@@ -0,0 +1,16 @@
+/*
+ * Static evaluation declarations
+ */
+
+#ifndef EVAL_H
+#define EVAL_H
+
+#include "chesslib/board.h"
+
+// Material value of a piece type in centipawns
+int evalPieceValue(pieceType pt);
+
+// Returns the evaluation of the position in centipawns from the point of view of the player to move
+int evalBoard(board *b);
+
+#endif
@@ -0,0 +1,106 @@
+/*
+ * Position key history implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "keyhistory.h"
+#include "zobrist.h"
+
+void keyHistoryInit(keyHistory *h)
+{
+	h->keys = NULL;
+	h->size = 0;
+	h->capacity = 0;
+}
+
+void keyHistoryFree(keyHistory *h)
+{
+	free(h->keys);
+	keyHistoryInit(h);
+}
+
+static void keyHistoryPush(keyHistory *h, uint64_t key)
+{
+	if (h->size == h->capacity)
+	{
+		h->capacity = h->capacity ? h->capacity * 2 : 256;
+		h->keys = (uint64_t *) realloc(h->keys, h->capacity * sizeof(uint64_t));
+	}
+
+	h->keys[h->size++] = key;
+}
+
+void keyHistoryReset(keyHistory *h, chess *c)
+{
+	h->size = 0;
+	keyHistoryPush(h, zobristHash(chessGetBoard(c)));
+}
+
+void keyHistoryReplay(keyHistory *h, const char *startFen, chess *c)
+{
+	chess *start = chessCreateFen(startFen);
+	board b = *chessGetBoard(start);
+	chessFree(start);
+
+	// The moves were legal when they were played, so they can go straight onto a board without chesslib checking them
+	h->size = 0;
+	keyHistoryPush(h, zobristHash(&b));
+	for (moveListNode *n = chessGetMoveHistory(c)->head; n; n = n->next)
+	{
+		board before = b;
+		boardPlayMoveInPlace(&b, n->move);
+		keyHistoryPush(h, zobristUpdate(keyHistoryCurrent(h), &before, &b, n->move));
+	}
+}
+
+int keyHistoryPlayMove(keyHistory *h, chess *c, move m)
+{
+	board before = *chessGetBoard(c);
+
+	int result = chessPlayMove(c, m);
+	if (result)
+		return result;
+
+	keyHistoryPush(h, zobristUpdate(keyHistoryCurrent(h), &before, chessGetBoard(c), m));
+	return 0;
+}
+
+void keyHistoryUndo(keyHistory *h, chess *c)
+{
+	size_t moves = chessGetMoveHistory(c)->size;
+
+	chessUndo(c);
+
+	if (chessGetMoveHistory(c)->size < moves && h->size > 1)
+		h->size--;
+
+#ifdef DEBUG
+	if (keyHistoryCurrent(h) != zobristHash(chessGetBoard(c)))
+		fprintf(stderr, "ERROR: Key history is out of sync with the game after undoing\n");
+#endif
+}
+
+uint64_t keyHistoryCurrent(keyHistory *h)
+{
+	return h->keys[h->size - 1];
+}
+
+int keyHistoryRepetitions(keyHistory *h, int halfMoveClock)
+{
+	int current = h->size - 1;
+	int oldest = current - halfMoveClock;
+	if (oldest < 0)
+		oldest = 0;
+
+	// Only positions with the same side to move can match
+	int count = 1;
+	for (int i = current - 2; i >= oldest; i -= 2)
+	{
+		if (h->keys[i] == h->keys[current])
+			count++;
+	}
+
+	return count;
+}
@@ -0,0 +1,44 @@
+/*
+ * Position key history declarations
+ */
+
+#ifndef KEYHISTORY_H
+#define KEYHISTORY_H
+
+#include <stdint.h>
+
+#include "chesslib/chess.h"
+
+// The Zobrist key of every position a game has been through, kept up to date incrementally as moves are played and
+// undone. Play and undo moves through this instead of calling chessPlayMove and chessUndo directly
+typedef struct
+{
+	uint64_t *keys;
+	int size;
+	int capacity;
+} keyHistory;
+
+void keyHistoryInit(keyHistory *h);
+void keyHistoryFree(keyHistory *h);
+
+// Forgets everything and starts over from the game's current position
+void keyHistoryReset(keyHistory *h, chess *c);
+
+// Forgets everything and records every position the game has been through instead, by replaying its moves from
+// startFen, which must be the position the game started from
+void keyHistoryReplay(keyHistory *h, const char *startFen, chess *c);
+
+// Plays the move with chessPlayMove and records the new key if it was legal. Returns chessPlayMove's result, so 0 means
+// the move was played
+int keyHistoryPlayMove(keyHistory *h, chess *c, move m);
+
+// Calls chessUndo, dropping the latest key if a move was taken back rather than a draw claim
+void keyHistoryUndo(keyHistory *h, chess *c);
+
+uint64_t keyHistoryCurrent(keyHistory *h);
+
+// Returns how many times the current position has occurred, including now. Only positions since the last capture or
+// pawn move can repeat, so the scan goes back at most halfMoveClock plies
+int keyHistoryRepetitions(keyHistory *h, int halfMoveClock);
+
+#endif
@@ -15,13 +15,43 @@
 #include "chesslib/chess.h"
 
 #include "main.h"
+#include "ai.h"
+#include "selfplay.h"
+#include "match.h"
+#include "uci.h"
+#include "aiworker.h"
+#include "engine.h"
+#include "zobrist.h"
+#include "threadpool.h"
+#include "perft.h"
+#include "keyhistory.h"
+#include "profiler.h"
+#include "debugtext.h"
+#include "analysis.h"
+#include "notation.h"
 
 #define SQUARE_SIZE 45.0f
 
+// The analysis panel sits to the right of the board, in the space calcView leaves free on wide windows
+#define ANALYSIS_BAR_WIDTH 8.0f
+#define ANALYSIS_MARGIN 4.0f
+#define ANALYSIS_TEXT_SIZE 1.0f
+#define ANALYSIS_PV_SHOWN 4
+
+// How often to check on the bot while it is thinking. It has no way to wake up a window waiting for events
+#define AI_POLL_INTERVAL_MS 10
+#define CIRCLE_POINT_COUNT 30
+
+// Transparent gap between pieces in an atlas, so mipmapping doesn't bleed neighbouring pieces into each other
+#define PIECE_ATLAS_PADDING 8
+
+#define CHECK_RADIUS (SQUARE_SIZE / 2.1f)
+#define LEGAL_MOVE_RADIUS (SQUARE_SIZE / 5.0f)
+#define LEGAL_CAPTURE_RADIUS (SQUARE_SIZE / 2.2f)
+
 // Define resources
 sfRenderWindow *window;
 
-sfRectangleShape *boardSquares[64];
 sfColor boardBlackColor;
 sfColor boardWhiteColor;
 sfColor boardHighlightColor;
@@ -30,19 +60,37 @@ sfColor checkColor;
 sfColor pieceTransparentColor;
 sfColor legalMoveColor;
 
-sfRectangleShape *highlightSquare;
-sq highlight1Sq;
-sq highlight2Sq;
-
-sfCircleShape *checkIndicator;
 
+// What gets drawn is only ever read from the current snapshot. updateGameState builds a new one in the other slot and
+// then switches to it, so a snapshot never changes once it is in use
+renderSnapshot snapshots[2];
+const renderSnapshot *snapshot = &snapshots[0];
 sqSet legalMoveSet;
-sfCircleShape *legalMoveIndicator;
-sfCircleShape *legalCaptureIndicator;
 
-pieceSet psCburnett;
-pieceSet psAlpha;
-pieceSet psTatiana;
+// The board is drawn from a few vertex arrays instead of one draw call per shape. Squares, highlights and check
+// indicators share one array, pieces share another drawn from the current atlas, and legal move dots go on top. They
+// are only rebuilt when boardDirty is set
+sfVertexArray *boardVertices;
+sfVertexArray *pieceVertices;
+sfVertexArray *overlayVertices;
+int boardDirty = 1;
+
+// Nothing on screen changes by itself, so a frame is only drawn when this or boardDirty is set
+int needsRedraw = 1;
+
+// Timing overlay, toggled with F3
+int showProfiler = 0;
+sfVertexArray *profilerVertices;
+
+// Live analysis, toggled with E. The panel is rebuilt whenever new results come in
+int showAnalysis = 0;
+analysisInfo analysis;
+sfVertexArray *analysisVertices;
+
+// Only the current set is loaded at startup, the others are loaded the first time they are selected
+pieceSet psCburnett = {"cburnett", NULL, 0};
+pieceSet psAlpha = {"alpha", NULL, 0};
+pieceSet psTatiana = {"tatiana", NULL, 0};
 
 pieceSet *currentPieceSet = &psTatiana;
 
@@ -57,6 +105,7 @@ sfSound *sndTerminal;
 int isDragging = 0;
 sq draggingSq;
 piece newDraggingPiece;
+sq ponderSq; // Where the dragged piece was last predicted to go
 int isFlipped = 0;
 int autoFlip = 0;
 int isFullscreen = 0;
@@ -67,12 +116,32 @@ int showLegals = 1;
 
 const char *initialFen;
 chess *g = NULL;
+keyHistory gameKeys;
+
+aiContext aiCtx;
+threadPool *aiPool;
+threadPool *analysisPool;
+threadPool *assetPool;
+uciEngine *engine = NULL;
 
 
 int main(int argc, char *argv[])
 {
-	// Set random seed
-	srand(time(NULL));
+	uint64_t seed = (uint64_t) time(NULL);
+	int selfPlayGames = 0;
+	int numThreads = 0;
+	int perftMode = 0;
+	int perftDepth = 0;
+	int perftSuite = 0;
+	int perftDivide = 0;
+	int perftSplitDepth = PERFT_DEFAULT_SPLIT_DEPTH;
+	const char *tracePath = NULL;
+	const char *bookPath = NULL;
+	const aiStrategy *matchStrategies[2] = {NULL, NULL};
+	int matchGames = MATCH_DEFAULT_GAMES;
+	const char *openingsPath = NULL;
+	int uciMode = 0;
+	const char *enginePath = NULL;
 
 	initialFen = INITIAL_FEN;
 
@@ -89,8 +158,259 @@ int main(int argc, char *argv[])
 			}
 			initialFen = argv[i];
 		}
+		else if (strcmp(argv[i], "--selfplay") == 0)
+		{
+			i++;
+			if (i >= argc)
+			{
+				fprintf(stderr, "ERROR: You must supply the number of games after the %s argument\n", argv[i - 1]);
+				return 1;
+			}
+			selfPlayGames = atoi(argv[i]);
+		}
+		else if ((strcmp(argv[i], "--threads") == 0) || (strcmp(argv[i], "-t") == 0))
+		{
+			i++;
+			if (i >= argc)
+			{
+				fprintf(stderr, "ERROR: You must supply the number of threads after the %s argument\n", argv[i - 1]);
+				return 1;
+			}
+			numThreads = atoi(argv[i]);
+		}
+		else if (strcmp(argv[i], "--seed") == 0)
+		{
+			i++;
+			if (i >= argc)
+			{
+				fprintf(stderr, "ERROR: You must supply a seed after the %s argument\n", argv[i - 1]);
+				return 1;
+			}
+			seed = strtoull(argv[i], NULL, 10);
+		}
+		else if ((strcmp(argv[i], "--depth") == 0) || (strcmp(argv[i], "-d") == 0))
+		{
+			i++;
+			if (i >= argc)
+			{
+				fprintf(stderr, "ERROR: You must supply a search depth after the %s argument\n", argv[i - 1]);
+				return 1;
+			}
+			aiConfig.searchDepth = atoi(argv[i]);
+		}
+		else if (strcmp(argv[i], "--nodes") == 0)
+		{
+			i++;
+			if (i >= argc)
+			{
+				fprintf(stderr, "ERROR: You must supply a node limit after the %s argument\n", argv[i - 1]);
+				return 1;
+			}
+			aiConfig.searchNodes = strtoull(argv[i], NULL, 10);
+		}
+		else if (strcmp(argv[i], "--movetime") == 0)
+		{
+			i++;
+			if (i >= argc)
+			{
+				fprintf(stderr, "ERROR: You must supply a time in milliseconds after the %s argument\n", argv[i - 1]);
+				return 1;
+			}
+			aiConfig.moveTimeMs = atoi(argv[i]);
+		}
+		else if (strcmp(argv[i], "--clock") == 0)
+		{
+			i++;
+			if (i >= argc)
+			{
+				fprintf(stderr, "ERROR: You must supply a time in milliseconds after the %s argument\n", argv[i - 1]);
+				return 1;
+			}
+			aiConfig.clockMs = atoi(argv[i]);
+		}
+		else if (strcmp(argv[i], "--increment") == 0)
+		{
+			i++;
+			if (i >= argc)
+			{
+				fprintf(stderr, "ERROR: You must supply a time in milliseconds after the %s argument\n", argv[i - 1]);
+				return 1;
+			}
+			aiConfig.incrementMs = atoi(argv[i]);
+		}
+		else if ((strcmp(argv[i], "--perft") == 0) || (strcmp(argv[i], "--divide") == 0))
+		{
+			i++;
+			if (i >= argc)
+			{
+				fprintf(stderr, "ERROR: You must supply a depth or \"suite\" after the %s argument\n", argv[i - 1]);
+				return 1;
+			}
+			perftMode = 1;
+			perftDivide = strcmp(argv[i - 1], "--divide") == 0;
+			if (strcmp(argv[i], "suite") == 0)
+				perftSuite = 1;
+			else
+				perftDepth = atoi(argv[i]);
+		}
+		else if (strcmp(argv[i], "--split") == 0)
+		{
+			i++;
+			if (i >= argc)
+			{
+				fprintf(stderr, "ERROR: You must supply a depth after the %s argument\n", argv[i - 1]);
+				return 1;
+			}
+			perftSplitDepth = atoi(argv[i]);
+		}
+		else if (strcmp(argv[i], "--hash") == 0)
+		{
+			i++;
+			if (i >= argc)
+			{
+				fprintf(stderr, "ERROR: You must supply a size in MB after the %s argument\n", argv[i - 1]);
+				return 1;
+			}
+			aiConfig.hashSizeMb = atoi(argv[i]);
+		}
+		else if (strcmp(argv[i], "--trace") == 0)
+		{
+			i++;
+			if (i >= argc)
+			{
+				fprintf(stderr, "ERROR: You must supply a file name after the %s argument\n", argv[i - 1]);
+				return 1;
+			}
+			tracePath = argv[i];
+		}
+		else if (strcmp(argv[i], "--book") == 0)
+		{
+			i++;
+			if (i >= argc)
+			{
+				fprintf(stderr, "ERROR: You must supply a book file after the %s argument\n", argv[i - 1]);
+				return 1;
+			}
+			bookPath = argv[i];
+		}
+		else if (strcmp(argv[i], "--uci") == 0)
+		{
+			uciMode = 1;
+		}
+		else if (strcmp(argv[i], "--engine") == 0)
+		{
+			i++;
+			if (i >= argc)
+			{
+				fprintf(stderr, "ERROR: You must supply an engine after the %s argument\n", argv[i - 1]);
+				return 1;
+			}
+			enginePath = argv[i];
+		}
+		else if (strcmp(argv[i], "--strategy") == 0)
+		{
+			i++;
+			if (i >= argc)
+			{
+				fprintf(stderr, "ERROR: You must supply a strategy after the %s argument\n", argv[i - 1]);
+				return 1;
+			}
+			aiConfig.strategy = findStrategyArg(argv[i]);
+			if (!aiConfig.strategy)
+				return 1;
+		}
+		else if (strcmp(argv[i], "--match") == 0)
+		{
+			if (i + 2 >= argc)
+			{
+				fprintf(stderr, "ERROR: You must supply two strategies after the %s argument\n", argv[i]);
+				return 1;
+			}
+			for (int j = 0; j < 2; j++)
+			{
+				matchStrategies[j] = findStrategyArg(argv[++i]);
+				if (!matchStrategies[j])
+					return 1;
+			}
+		}
+		else if (strcmp(argv[i], "--games") == 0)
+		{
+			i++;
+			if (i >= argc)
+			{
+				fprintf(stderr, "ERROR: You must supply the number of games after the %s argument\n", argv[i - 1]);
+				return 1;
+			}
+			matchGames = atoi(argv[i]);
+		}
+		else if (strcmp(argv[i], "--openings") == 0)
+		{
+			i++;
+			if (i >= argc)
+			{
+				fprintf(stderr, "ERROR: You must supply a file name after the %s argument\n", argv[i - 1]);
+				return 1;
+			}
+			openingsPath = argv[i];
+		}
 	}
 
+	// Wrong keys would only keep the book from finding its positions, so everything else still works without it
+	if (bookPath && !zobristCheckKeys())
+	{
+		fprintf(stderr, "WARNING: Not using the opening book %s\n", bookPath);
+	}
+	else if (bookPath)
+	{
+		aiConfig.book = bookOpen(bookPath);
+		if (!aiConfig.book)
+			return 1;
+	}
+
+	// Headless modes never open a window
+	if (uciMode)
+		return uciRun(seed, numThreads);
+	if (perftSuite)
+		return perftRunSuite(numThreads, perftSplitDepth);
+	if (perftMode)
+		return perftRun(initialFen, perftDepth, perftDivide, numThreads, perftSplitDepth);
+	if (selfPlayGames)
+		return selfPlayRun(selfPlayGames, numThreads, initialFen, seed);
+	if (matchStrategies[0])
+		return matchRun(matchStrategies[0], matchStrategies[1], matchGames, numThreads, openingsPath, initialFen, seed);
+
+	if (!profilerInit(tracePath))
+		return 1;
+
+	// The bot only ever thinks on one thread at a time, so the foreground and background contexts can share a pool
+	aiPool = threadPoolCreate(numThreads);
+
+	aiInit(&aiCtx, seed);
+	aiSetPool(&aiCtx, aiPool);
+	aiWorkerInit(seed + 1, aiPool);
+
+	// The analysis keeps searching while the bot thinks, so it can't share the bot's pool
+	analysisPool = threadPoolCreate(numThreads);
+	analysisInit(seed + 2, analysisPool);
+
+	// The engine is started once and kept for every game, so it only pays its startup cost once
+	if (enginePath)
+	{
+		engine = engineStart(enginePath);
+		if (!engine)
+			return 1;
+		aiWorkerSetEngine(engine);
+	}
+
+	// Decode the assets needed for the first frame in parallel. The bot may be using its pool later on when a piece set
+	// is loaded, so assets get their own
+	assetPool = threadPoolCreate(numThreads);
+
+	assetBatch startupAssets;
+	startupAssets.ps = currentPieceSet;
+	startupAssets.loadSounds = 1;
+	loadAssets(&startupAssets);
+
 	// Create the window
 	sfVideoMode mode = {720, 720, 32};
 	// Default values taken from https://www.sfml-dev.org/documentation/2.5.1/structsf_1_1ContextSettings.php
@@ -114,20 +434,18 @@ int main(int argc, char *argv[])
 	sfRenderWindow_setVerticalSyncEnabled(window, sfTrue);
 
 	// Load textures
-	loadPieceSet(&psCburnett, "cburnett");
-	loadPieceSet(&psTatiana, "tatiana");
-	loadPieceSet(&psAlpha, "alpha");
+	buildPieceSet(currentPieceSet, &startupAssets);
 
 	// Set window icon
-	sfVector2u texSize = sfTexture_getSize(psTatiana.wN);
-	sfImage *iconImage = sfTexture_copyToImage(psTatiana.wN);
+	sfVector2u texSize = {currentPieceSet->pieceSize, currentPieceSet->pieceSize};
+	sfImage *atlasImage = sfTexture_copyToImage(currentPieceSet->atlas);
+	sfImage *iconImage = sfImage_createFromColor(texSize.x, texSize.y, sfTransparent);
+	sfImage_copyImage(iconImage, atlasImage, 0, 0, getPieceTexRect(currentPieceSet, pWKnight), sfFalse);
+	sfImage_destroy(atlasImage);
 	sfRenderWindow_setIcon(window, texSize.x, texSize.y, sfImage_getPixelsPtr(iconImage));
 
 	// Create piece sprite. This will be reused for each piece drawing
 	sprPiece = sfSprite_create();
-	float size = (float) texSize.x; 	// Assumes square pieces, all the same size
-	sfSprite_setScale(sprPiece, (sfVector2f) {SQUARE_SIZE / size, SQUARE_SIZE / size});
-	sfSprite_setOrigin(sprPiece, (sfVector2f) {size / 2.0f, size / 2.0f});
 
 	// Define board colors
 	boardBlackColor = sfColor_fromRGB(167, 129, 177);
@@ -138,55 +456,29 @@ int main(int argc, char *argv[])
 	pieceTransparentColor = sfColor_fromRGBA(255, 255, 255, 70);
 	legalMoveColor = sfColor_fromRGBA(0, 0, 0, 100);
 
-	// Create board squares
-	for (int i = 0; i < 64; i++)
-	{
-		sfRectangleShape *s = sfRectangleShape_create();
-
-		sfRectangleShape_setSize(s, (sfVector2f) {SQUARE_SIZE, SQUARE_SIZE});
-		sfRectangleShape_setPosition(s, (sfVector2f) {(float) (i % 8) * SQUARE_SIZE, floor(i / 8) * SQUARE_SIZE});
-
-		int isBlack = (i + (int) floor(i / 8)) % 2;
-		sfRectangleShape_setFillColor(s, isBlack ? boardBlackColor : boardWhiteColor);
-
-		boardSquares[i] = s;
-	}
-
-	// Create highlight square
-	highlightSquare = sfRectangleShape_create();
-
-	sfRectangleShape_setSize(highlightSquare, (sfVector2f) {SQUARE_SIZE, SQUARE_SIZE});
-	sfRectangleShape_setFillColor(highlightSquare, boardHighlightColor);
-
-	// Create check indicator
-	checkIndicator = sfCircleShape_create();
-
-	sfCircleShape_setRadius(checkIndicator, SQUARE_SIZE / 2.1f);
-	sfCircleShape_setOrigin(checkIndicator, (sfVector2f) {SQUARE_SIZE / 2.1f, SQUARE_SIZE / 2.1f});
-	sfCircleShape_setFillColor(checkIndicator, checkColor);
-
-	// Create legal move indicator
-	legalMoveIndicator = sfCircleShape_create();
-
-	sfCircleShape_setRadius(legalMoveIndicator, SQUARE_SIZE / 5.0f);
-	sfCircleShape_setOrigin(legalMoveIndicator, (sfVector2f) {SQUARE_SIZE / 5.0f, SQUARE_SIZE / 5.0f});
-	sfCircleShape_setFillColor(legalMoveIndicator, legalMoveColor);
-
-	legalCaptureIndicator = sfCircleShape_create();
-
-	sfCircleShape_setRadius(legalCaptureIndicator, SQUARE_SIZE / 2.2f);
-	sfCircleShape_setOrigin(legalCaptureIndicator, (sfVector2f) {SQUARE_SIZE / 2.2f, SQUARE_SIZE / 2.2f});
-	sfCircleShape_setFillColor(legalCaptureIndicator, legalMoveColor);
+	// Create the vertex arrays the board is drawn from
+	boardVertices = sfVertexArray_create();
+	sfVertexArray_setPrimitiveType(boardVertices, sfTriangles);
+	pieceVertices = sfVertexArray_create();
+	sfVertexArray_setPrimitiveType(pieceVertices, sfTriangles);
+	overlayVertices = sfVertexArray_create();
+	sfVertexArray_setPrimitiveType(overlayVertices, sfTriangles);
+	profilerVertices = sfVertexArray_create();
+	sfVertexArray_setPrimitiveType(profilerVertices, sfTriangles);
+	analysisVertices = sfVertexArray_create();
+	sfVertexArray_setPrimitiveType(analysisVertices, sfTriangles);
 
 	calcView();
 
+	keyHistoryInit(&gameKeys);
+	aiCtx.history = &gameKeys;
 	initChess();
 
 	// Create sounds
-	sfSoundBuffer *sbMove = sfSoundBuffer_createFromFile("snd/move.wav");
-	sfSoundBuffer *sbCapture = sfSoundBuffer_createFromFile("snd/capture.wav");
-	sfSoundBuffer *sbCheck = sfSoundBuffer_createFromFile("snd/check.wav");
-	sfSoundBuffer *sbTerminal = sfSoundBuffer_createFromFile("snd/terminal.wav");
+	sfSoundBuffer *sbMove = startupAssets.soundBuffers[0];
+	sfSoundBuffer *sbCapture = startupAssets.soundBuffers[1];
+	sfSoundBuffer *sbCheck = startupAssets.soundBuffers[2];
+	sfSoundBuffer *sbTerminal = startupAssets.soundBuffers[3];
 
 	sndMove = sfSound_create();
 	sfSound_setBuffer(sndMove, sbMove);
@@ -201,9 +493,19 @@ int main(int argc, char *argv[])
 	// Main loop
 	while (sfRenderWindow_isOpen(window))
 	{
-		// Handle events
+		// Handle events. With nothing to draw, no bot to wait for and no analysis running, sleep until something happens
 		sfEvent event;
-		while (sfRenderWindow_pollEvent(window, &event))
+		int hasEvent;
+		if (!needsRedraw && !boardDirty && !aiWorkerIsBusy() && !(showAnalysis && analysisIsBusy()))
+			hasEvent = sfRenderWindow_waitEvent(window, &event);
+		else
+			hasEvent = sfRenderWindow_pollEvent(window, &event);
+
+		// Waiting for the first event isn't part of the frame
+		int64_t frameStart = profileBegin();
+		int64_t eventsStart = frameStart;
+
+		for (; hasEvent; hasEvent = sfRenderWindow_pollEvent(window, &event))
 		{
 			if (event.type == sfEvtClosed)
 			{
@@ -212,6 +514,28 @@ int main(int argc, char *argv[])
 			else if (event.type == sfEvtResized)
 			{
 				calcView();
+				needsRedraw = 1;
+			}
+			else if (event.type == sfEvtGainedFocus)
+			{
+				needsRedraw = 1;
+			}
+			else if (event.type == sfEvtMouseMoved)
+			{
+				// The dragged piece follows the mouse
+				if (isDragging)
+				{
+					needsRedraw = 1;
+
+					// Guess that the piece will be dropped where it's hovering, and start working out a reply
+					sq s;
+					if (doRandomMoves && getMouseSquare(event.mouseMove.x, event.mouseMove.y, &s) &&
+							sqSetGet(&legalMoveSet, s) && !sqEq(s, ponderSq))
+					{
+						ponderSq = s;
+						aiWorkerPonder(g, getDraggedMove(s));
+					}
+				}
 			}
 			else if (event.type == sfEvtMouseButtonPressed)
 			{
@@ -221,7 +545,7 @@ int main(int argc, char *argv[])
 					piece p;
 					if (getMouseSquare(event.mouseButton.x, event.mouseButton.y, &s))
 					{
-						if (chessGetTerminalState(g) == tsOngoing)
+						if (chessGetTerminalState(g) == tsOngoing && !aiWorkerIsBusy())
 						{
 							p = chessGetPiece(g, s);
 
@@ -230,8 +554,10 @@ int main(int argc, char *argv[])
 								isDragging = 1;
 								draggingSq = s;
 								newDraggingPiece = pEmpty;
+								ponderSq = SQ_INVALID;
 
 								legalMoveSet = getLegalSquareSet(s);
+								boardDirty = 1;
 							}
 						}
 					}
@@ -244,66 +570,55 @@ int main(int argc, char *argv[])
 					if (isDragging)
 					{
 						isDragging = 0;
+						boardDirty = 1;
 
+						int moved = 0;
 						sq s;
 						if (getMouseSquare(event.mouseButton.x, event.mouseButton.y, &s))
 						{
-							move m = moveSq(draggingSq, s);
-							if (pieceGetType(chessGetPiece(g, draggingSq)) == ptPawn && (s.rank == 1 || s.rank == 8))
-								m.promotion = ptQueen;
+							move m = getDraggedMove(s);
 
 							uint8_t isCapture = (chessGetPiece(g, s) != pEmpty) ||
 									(pieceGetType(chessGetPiece(g, draggingSq)) == ptPawn && (s.file != draggingSq.file));
 
-							if (!chessPlayMove(g, m))
+							// Dropping a piece somewhere it can't go doesn't need to ask the game
+							if (sqSetGet(&legalMoveSet, s) && !keyHistoryPlayMove(&gameKeys, g, m))
 							{
 								uint8_t isCheck = chessIsInCheck(g) && (chessGetTerminalState(g) == tsOngoing);
 
-								if (doRandomMoves && (chessGetTerminalState(g) == tsOngoing))
-								{
-									board *aiBoard = chessGetBoard(g);
-									playAiMove();
-
-									move aiMove = chessGetMoveHistory(g)->tail->move;
-
-									isCapture |= boardGetPiece(aiBoard, aiMove.to) ||
-											(pieceGetType(boardGetPiece(aiBoard, aiMove.from)) == ptPawn
-											&& aiMove.to.file != aiMove.from.file);
-
-									isCheck |= chessIsInCheck(g);
-								}
-
-								if (playSound)
-								{
-									if (isCapture)
-										sfSound_play(sndCapture);
-									else
-										sfSound_play(sndMove);
-
-									if (chessGetTerminalState(g) != tsOngoing)
-										sfSound_play(sndTerminal);
-									else if (isCheck)
-										sfSound_play(sndCheck);
-								}
+								playMoveSound(isCapture, isCheck);
 
 								updateGameState();
+								moved = 1;
+
+								if (doRandomMoves)
+									aiWorkerStart(g);
 							}
 						}
+
+						// Dropped back where it came from, off the board or somewhere it can't go, so the guess is
+						// wrong and the search for it would only keep the CPU busy
+						if (!moved)
+							aiWorkerStopPondering();
 					}
 				}
 			}
 			else if (event.type == sfEvtKeyPressed)
 			{
+				needsRedraw = 1;
+
 				switch (event.key.code)
 				{
 					case sfKeyR:
 						if (isDragging)
 							break;
+						aiWorkerCancel();
 						initChess();
 						break;
 
 					case sfKeyF:
 						isFlipped = !isFlipped;
+						boardDirty = 1;
 						break;
 
 					case sfKeyA:
@@ -312,6 +627,7 @@ int main(int argc, char *argv[])
 
 					case sfKeyH:
 						showHighlighting = !showHighlighting;
+						boardDirty = 1;
 						break;
 
 					case sfKeyS:
@@ -325,37 +641,14 @@ int main(int argc, char *argv[])
 					case sfKeySpace:
 						if (isDragging)
 							break;
-						if (chessGetTerminalState(g) == tsOngoing)
-						{
-							board *aiBoard = chessGetBoard(g);
-							playAiMove();
-
-							move aiMove = chessGetMoveHistory(g)->tail->move;
-
-							uint8_t isCapture = boardGetPiece(aiBoard, aiMove.to) ||
-									(pieceGetType(boardGetPiece(aiBoard, aiMove.from)) == ptPawn
-									&& aiMove.to.file != aiMove.from.file);
-
-							if (playSound)
-							{
-								if (isCapture)
-									sfSound_play(sndCapture);
-								else
-									sfSound_play(sndMove);
-
-								if (chessGetTerminalState(g) != tsOngoing)
-									sfSound_play(sndTerminal);
-								else if (chessIsInCheck(g))
-									sfSound_play(sndCheck);
-							}
-
-							updateGameState();
-						}
+						aiWorkerStart(g);
 						break;
 
 					case sfKeyEnter:
 						if (event.key.alt)
 						{
+							aiWorkerCancel();
+
 							isFullscreen = !isFullscreen;
 							sfRenderWindow_destroy(window);
 
@@ -375,12 +668,13 @@ int main(int argc, char *argv[])
 					case sfKeyG:
 						if (isDragging)
 							break;
+						aiWorkerCancel();
 						if (chessGetTerminalState(g) != tsOngoing)
 							initChess();
 						while (chessGetTerminalState(g) == tsOngoing)
 						{
-							move m = aiGetMove();
-							chessPlayMove(g, m);
+							move m = aiGetMove(&aiCtx, g);
+							keyHistoryPlayMove(&gameKeys, g, m);
 						}
 
 						updateGameState();
@@ -389,7 +683,8 @@ int main(int argc, char *argv[])
 					case sfKeyZ:
 						if (isDragging)
 							break;
-						chessUndo(g);
+						aiWorkerCancel();
+						keyHistoryUndo(&gameKeys, g);
 
 						updateGameState();
 						break;
@@ -397,17 +692,18 @@ int main(int argc, char *argv[])
 					case sfKeyC:
 						if (isDragging)
 							break;
+						aiWorkerCancel();
 						if (chessCanClaimDraw50(g))
 						{
 							chessClaimDraw50(g);
-							updateWindowTitle();
+							updateGameState();
 							if (playSound)
 								sfSound_play(sndTerminal);
 						}
 						else if (chessCanClaimDrawThreefold(g))
 						{
 							chessClaimDrawThreefold(g);
-							updateWindowTitle();
+							updateGameState();
 							if (playSound)
 								sfSound_play(sndTerminal);
 						}
@@ -415,15 +711,29 @@ int main(int argc, char *argv[])
 
 					case sfKeyL:
 						showLegals = !showLegals;
+						boardDirty = 1;
+						break;
+
+					case sfKeyE:
+						showAnalysis = !showAnalysis;
+						if (showAnalysis)
+							analysisStart(g);
+						else
+							analysisStop();
+						break;
+
+					case sfKeyF3:
+						showProfiler = !showProfiler;
+						profilerSetEnabled(showProfiler);
 						break;
 
 					case sfKeyP:
 						if (currentPieceSet == &psCburnett)
-							currentPieceSet = &psAlpha;
+							selectPieceSet(&psAlpha);
 						else if (currentPieceSet == &psAlpha)
-							currentPieceSet = &psTatiana;
+							selectPieceSet(&psTatiana);
 						else
-							currentPieceSet = &psCburnett;
+							selectPieceSet(&psCburnett);
 						break;
 
 					default:
@@ -432,42 +742,54 @@ int main(int argc, char *argv[])
 			}
 		}
 
+		profileEnd(pzEvents, eventsStart);
+
+		// Apply the bot's move once the worker has finished searching
+		move aiMove;
+		if (aiWorkerPoll(&aiMove))
+			playAiMove(aiMove);
+
+		if (showAnalysis && analysisPoll(&analysis))
+		{
+			buildAnalysisVertices();
+			needsRedraw = 1;
+		}
+
+		if (!sfRenderWindow_isOpen(window))
+			break;
+
+		if (!needsRedraw && !boardDirty)
+		{
+			if (aiWorkerIsBusy() || (showAnalysis && analysisIsBusy()))
+				sfSleep(sfMilliseconds(AI_POLL_INTERVAL_MS));
+			continue;
+		}
+
+		needsRedraw = 0;
+
 		// Draw to window
 		sfRenderWindow_clear(window, backgroundColor);
 
 		// Draw the board
-		for (int i = 0; i < 64; i++)
+		if (boardDirty)
 		{
-			sq s;
-			s.file = (i % 8) + 1;
-			s.rank = 8 - floor(i / 8);
-
-			int index = isFlipped ? 63 - i : i;
-
-			sfRenderWindow_drawRectangleShape(window, boardSquares[index], NULL);
+			int64_t buildStart = profileBegin();
+			buildBoardVertices();
+			if (showAnalysis)
+				buildAnalysisVertices();
+			profileEnd(pzBoardBuild, buildStart);
+			boardDirty = 0;
+		}
 
-			if (showHighlighting && (sqEq(s, highlight1Sq) || sqEq(s, highlight2Sq)))
-			{
-				sfRectangleShape_setPosition(highlightSquare, sfRectangleShape_getPosition(boardSquares[index]));
-				sfRenderWindow_drawRectangleShape(window, highlightSquare, NULL);
-			}
+		sfRenderWindow_drawVertexArray(window, boardVertices, NULL);
 
-			piece p = chessGetPiece(g, s);
-			if (p)
-			{
-				pieceType pt = pieceGetType(p);
+		sfRenderStates pieceStates = {sfBlendAlpha, sfTransform_Identity, currentPieceSet->atlas, NULL};
+		sfRenderWindow_drawVertexArray(window, pieceVertices, &pieceStates);
 
-				if (pt == ptKing && chessIsSquareAttacked(g, s))
-					drawCircleShape(checkIndicator, s);
-				drawBoardPiece(p, s);
-			}
+		sfRenderWindow_drawVertexArray(window, overlayVertices, NULL);
 
-			if (showLegals && isDragging)
-			{
-				if (sqSetGet(&legalMoveSet, s))
-					drawCircleShape(p ? legalCaptureIndicator : legalMoveIndicator, s);
-			}
-		}
+		if (showAnalysis)
+			sfRenderWindow_drawVertexArray(window, analysisVertices, NULL);
 
 		// Draw currently dragged piece
 		if (isDragging)
@@ -476,7 +798,7 @@ int main(int argc, char *argv[])
 			if (newDraggingPiece)
 				p = newDraggingPiece;
 			else
-				p = chessGetPiece(g, draggingSq);
+				p = snapshot->pieces[getSquareIndex(draggingSq)];
 
 			if (p)
 			{
@@ -486,25 +808,41 @@ int main(int argc, char *argv[])
 			}
 		}
 
+		if (showProfiler)
+			drawProfilerOverlay();
+
+		int64_t displayStart = profileBegin();
 		sfRenderWindow_display(window);
+		profileEnd(pzDisplay, displayStart);
+
+		profileEnd(pzFrame, frameStart);
 	}
 
 	// Cleanup and exit
-	sfRenderWindow_destroy(window);
+	aiWorkerDestroy();
+	analysisDestroy();
+	engineStop(engine);
+	aiFree(&aiCtx);
+	keyHistoryFree(&gameKeys);
+	bookClose(aiConfig.book);
+	threadPoolFree(aiPool);
+	threadPoolFree(analysisPool);
+	threadPoolFree(assetPool);
 
-	for (int i = 0; i < 64; i++)
-		sfRectangleShape_destroy(boardSquares[i]);
+	sfRenderWindow_destroy(window);
 
 	destroyPieceSet(&psCburnett);
 	destroyPieceSet(&psAlpha);
 	destroyPieceSet(&psTatiana);
 
-	sfRectangleShape_destroy(highlightSquare);
-	sfCircleShape_destroy(checkIndicator);
-	sfCircleShape_destroy(legalMoveIndicator);
-	sfCircleShape_destroy(legalCaptureIndicator);
+	sfVertexArray_destroy(boardVertices);
+	sfVertexArray_destroy(pieceVertices);
+	sfVertexArray_destroy(overlayVertices);
+	sfVertexArray_destroy(profilerVertices);
+	sfVertexArray_destroy(analysisVertices);
 
 	sfSprite_destroy(sprPiece);
+	sfImage_destroy(iconImage);
 
 	sfSoundBuffer_destroy(sbMove);
 	sfSoundBuffer_destroy(sbCapture);
@@ -516,55 +854,100 @@ int main(int argc, char *argv[])
 	sfSound_destroy(sndCheck);
 	sfSound_destroy(sndTerminal);
 
+	profilerShutdown();
+
 	return 0;
 }
 
-void loadPieceSet(pieceSet *ps, const char *name)
+void loadAssets(assetBatch *batch)
+{
+	int count = batch->loadSounds ? SOUND_COUNT : 0;
+	if (batch->ps)
+		count += PIECE_SET_SIZE;
+
+	threadPoolRun(assetPool, loadAssetTask, batch, count);
+}
+
+void loadAssetTask(void *userData, int workerIndex, int taskIndex)
 {
-	char *filename = (char *) malloc(strlen(name) + 12); // img/NAME/xX.png
-
-	sprintf(filename, "img/%s/wP.png", name);
-	ps->wP = sfTexture_createFromFile(filename, NULL);
-	sprintf(filename, "img/%s/wN.png", name);
-	ps->wN = sfTexture_createFromFile(filename, NULL);
-	sprintf(filename, "img/%s/wB.png", name);
-	ps->wB = sfTexture_createFromFile(filename, NULL);
-	sprintf(filename, "img/%s/wR.png", name);
-	ps->wR = sfTexture_createFromFile(filename, NULL);
-	sprintf(filename, "img/%s/wQ.png", name);
-	ps->wQ = sfTexture_createFromFile(filename, NULL);
-	sprintf(filename, "img/%s/wK.png", name);
-	ps->wK = sfTexture_createFromFile(filename, NULL);
-
-	sprintf(filename, "img/%s/bP.png", name);
-	ps->bP = sfTexture_createFromFile(filename, NULL);
-	sprintf(filename, "img/%s/bN.png", name);
-	ps->bN = sfTexture_createFromFile(filename, NULL);
-	sprintf(filename, "img/%s/bB.png", name);
-	ps->bB = sfTexture_createFromFile(filename, NULL);
-	sprintf(filename, "img/%s/bR.png", name);
-	ps->bR = sfTexture_createFromFile(filename, NULL);
-	sprintf(filename, "img/%s/bQ.png", name);
-	ps->bQ = sfTexture_createFromFile(filename, NULL);
-	sprintf(filename, "img/%s/bK.png", name);
-	ps->bK = sfTexture_createFromFile(filename, NULL);
-
-	free(filename);
+	assetBatch *batch = (assetBatch *) userData;
+
+	if (batch->ps)
+	{
+		if (taskIndex < PIECE_SET_SIZE)
+		{
+			const char *pieceNames[PIECE_SET_SIZE] = {"wP", "wN", "wB", "wR", "wQ", "wK", "bP", "bN", "bB", "bR", "bQ", "bK"};
+
+			char *filename = (char *) malloc(strlen(batch->ps->name) + 12); // img/NAME/xX.png
+			sprintf(filename, "img/%s/%s.png", batch->ps->name, pieceNames[taskIndex]);
+
+			batch->pieceImages[taskIndex] = sfImage_createFromFile(filename);
+			if (!batch->pieceImages[taskIndex])
+				fprintf(stderr, "ERROR: Unable to load %s\n", filename);
+
+			free(filename);
+			return;
+		}
+
+		taskIndex -= PIECE_SET_SIZE;
+	}
+
+	// OpenAL buffers aren't tied to a thread like GL textures are, so sounds can be created right here
+	const char *soundFiles[SOUND_COUNT] = {"snd/move.wav", "snd/capture.wav", "snd/check.wav", "snd/terminal.wav"};
+	batch->soundBuffers[taskIndex] = sfSoundBuffer_createFromFile(soundFiles[taskIndex]);
+}
+
+void buildPieceSet(pieceSet *ps, assetBatch *batch)
+{
+	sfImage *atlasImage = NULL;
+	unsigned int stride = 0;
+	for (int i = 0; i < PIECE_SET_SIZE; i++)
+	{
+		sfImage *image = batch->pieceImages[i];
+		if (!image)
+			continue;
+
+		if (!atlasImage)
+		{
+			ps->pieceSize = sfImage_getSize(image).x; 	// Assumes square pieces, all the same size
+			stride = ps->pieceSize + PIECE_ATLAS_PADDING;
+			atlasImage = sfImage_createFromColor(6 * stride, 2 * stride, sfTransparent);
+		}
+
+		sfImage_copyImage(atlasImage, image, (i % 6) * stride, (i / 6) * stride, (sfIntRect) {0, 0, 0, 0}, sfFalse);
+		sfImage_destroy(image);
+	}
+
+	if (!atlasImage)
+		return;
+
+	ps->atlas = sfTexture_createFromImage(atlasImage, NULL);
+	sfImage_destroy(atlasImage);
 
 	// Set texture scaling
-	sfTexture **pieceSetTextureArray = (sfTexture **) ps;
-	for (int i = 0; i < 12; i++)
+	sfTexture_setSmooth(ps->atlas, sfTrue);
+	sfTexture_generateMipmap(ps->atlas);
+}
+
+void selectPieceSet(pieceSet *ps)
+{
+	if (!ps->atlas)
 	{
-		sfTexture_setSmooth(pieceSetTextureArray[i], sfTrue);
-		sfTexture_generateMipmap(pieceSetTextureArray[i]);
+		assetBatch batch;
+		batch.ps = ps;
+		batch.loadSounds = 0;
+		loadAssets(&batch);
+		buildPieceSet(ps, &batch);
 	}
+
+	currentPieceSet = ps;
+	boardDirty = 1;
 }
 
 void destroyPieceSet(pieceSet *ps)
 {
-	sfTexture **pieceSetTextureArray = (sfTexture **) ps;
-	for (int i = 0; i < 12; i++)
-		sfTexture_destroy(pieceSetTextureArray[i]);
+	if (ps->atlas)
+		sfTexture_destroy(ps->atlas);
 }
 
 void calcView()
@@ -601,91 +984,249 @@ void calcView()
 
 void drawPiece(piece p, sfVector2f coords)
 {
-	sfTexture *tex = getPieceTex(p);
+	float size = (float) currentPieceSet->pieceSize;
 
-	sfSprite_setTexture(sprPiece, tex, sfFalse);
+	sfSprite_setTexture(sprPiece, currentPieceSet->atlas, sfFalse);
+	sfSprite_setTextureRect(sprPiece, getPieceTexRect(currentPieceSet, p));
+	sfSprite_setScale(sprPiece, (sfVector2f) {SQUARE_SIZE / size, SQUARE_SIZE / size});
+	sfSprite_setOrigin(sprPiece, (sfVector2f) {size / 2.0f, size / 2.0f});
 	sfSprite_setPosition(sprPiece, coords);
 	sfRenderWindow_drawSprite(window, sprPiece, NULL);
 }
 
-void drawBoardPiece(piece p, sq s)
+sfVector2f getSquareCenter(sq s)
 {
-	int coordsFile, coordsRank;
+	uint8_t file = s.file;
+	uint8_t rank = s.rank;
 
 	if (isFlipped)
 	{
-		coordsFile = 9 - s.file;
-		coordsRank = 9 - s.rank;
+		file = 9 - file;
+		rank = 9 - rank;
 	}
-	else
+
+	return (sfVector2f) {((float) file - 0.5) * SQUARE_SIZE, (8.5 - (float) rank) * SQUARE_SIZE};
+}
+
+void appendQuad(sfVertexArray *va, sfVector2f center, float size, sfColor color, sfIntRect texRect)
+{
+	float half = size / 2.0f;
+	sfVector2f corners[4] =
 	{
-		coordsFile = s.file;
-		coordsRank = s.rank;
+		{center.x - half, center.y - half},
+		{center.x + half, center.y - half},
+		{center.x + half, center.y + half},
+		{center.x - half, center.y + half}
+	};
+	float left = (float) texRect.left;
+	float top = (float) texRect.top;
+	float right = (float) (texRect.left + texRect.width);
+	float bottom = (float) (texRect.top + texRect.height);
+	sfVector2f texCoords[4] = {{left, top}, {right, top}, {right, bottom}, {left, bottom}};
+
+	// Two triangles, so everything in the board can share one primitive type
+	const int order[6] = {0, 1, 2, 0, 2, 3};
+	for (int i = 0; i < 6; i++)
+		sfVertexArray_append(va, (sfVertex) {corners[order[i]], color, texCoords[order[i]]});
+}
+
+void appendRect(sfVertexArray *va, sfFloatRect rect, sfColor color)
+{
+	sfVector2f corners[4] =
+	{
+		{rect.left, rect.top},
+		{rect.left + rect.width, rect.top},
+		{rect.left + rect.width, rect.top + rect.height},
+		{rect.left, rect.top + rect.height}
+	};
+
+	const int order[6] = {0, 1, 2, 0, 2, 3};
+	for (int i = 0; i < 6; i++)
+		sfVertexArray_append(va, (sfVertex) {corners[order[i]], color, {0.0f, 0.0f}});
+}
+
+void appendCircle(sfVertexArray *va, sfVector2f center, float radius, sfColor color)
+{
+	sfVector2f prev = {center.x + radius, center.y};
+	for (int i = 1; i <= CIRCLE_POINT_COUNT; i++)
+	{
+		float angle = (float) i * 2.0f * (float) M_PI / CIRCLE_POINT_COUNT;
+		sfVector2f next = {center.x + radius * cosf(angle), center.y + radius * sinf(angle)};
+
+		sfVertexArray_append(va, (sfVertex) {center, color, {0.0f, 0.0f}});
+		sfVertexArray_append(va, (sfVertex) {prev, color, {0.0f, 0.0f}});
+		sfVertexArray_append(va, (sfVertex) {next, color, {0.0f, 0.0f}});
+
+		prev = next;
 	}
+}
 
-	sfVector2f coords = (sfVector2f) {((float) coordsFile - 0.5) * SQUARE_SIZE,
-			(8.5 - (float) coordsRank) * SQUARE_SIZE};
+void buildBoardVertices()
+{
+	sfVertexArray_clear(boardVertices);
+	sfVertexArray_clear(pieceVertices);
+	sfVertexArray_clear(overlayVertices);
 
-	if (isDragging && sqEq(draggingSq, s))
+	for (int i = 0; i < 64; i++)
 	{
-		sfSprite_setColor(sprPiece, pieceTransparentColor);
-		drawPiece(p, coords);
-		sfSprite_setColor(sprPiece, sfWhite);
+		sq s;
+		s.file = (i % 8) + 1;
+		s.rank = (i / 8) + 1;
+
+		sfVector2f center = getSquareCenter(s);
+
+		int isBlack = (s.file + s.rank) % 2 == 0;
+		appendQuad(boardVertices, center, SQUARE_SIZE, isBlack ? boardBlackColor : boardWhiteColor, (sfIntRect) {0, 0, 0, 0});
+
+		if (showHighlighting && (sqEq(s, snapshot->highlight1Sq) || sqEq(s, snapshot->highlight2Sq)))
+			appendQuad(boardVertices, center, SQUARE_SIZE, boardHighlightColor, (sfIntRect) {0, 0, 0, 0});
+
+		piece p = snapshot->pieces[i];
+		if (p)
+		{
+			if (sqEq(s, snapshot->checkSq))
+				appendCircle(boardVertices, center, CHECK_RADIUS, checkColor);
+
+			sfColor color = (isDragging && sqEq(draggingSq, s)) ? pieceTransparentColor : sfWhite;
+			appendQuad(pieceVertices, center, SQUARE_SIZE, color, getPieceTexRect(currentPieceSet, p));
+		}
+
+		if (showLegals && isDragging && sqSetGet(&legalMoveSet, s))
+			appendCircle(overlayVertices, center, p ? LEGAL_CAPTURE_RADIUS : LEGAL_MOVE_RADIUS, legalMoveColor);
 	}
-	else
+}
+
+void drawProfilerOverlay()
+{
+	char text[1024];
+	int length = sprintf(text, "%-14s %7s %7s %7s\n", "zone ms", "last", "avg", "max");
+	for (int i = 0; i < PROFILE_ZONE_COUNT; i++)
 	{
-		drawPiece(p, coords);
+		profileStats stats;
+		profilerGetStats(i, &stats);
+		length += sprintf(text + length, "%-14s %7.2f %7.2f %7.2f\n", profileZoneName(i), stats.lastMs, stats.avgMs,
+				stats.maxMs);
 	}
+
+	// Drawn in window pixels, so the overlay stays readable however the board is scaled
+	float pixelSize = 2.0f;
+	float margin = 4.0f * pixelSize;
+	float width = 38 * DEBUG_TEXT_ADVANCE * pixelSize;
+	float height = (PROFILE_ZONE_COUNT + 1) * DEBUG_TEXT_LINE_HEIGHT * pixelSize;
+
+	sfVertexArray_clear(profilerVertices);
+	appendRect(profilerVertices, (sfFloatRect) {margin, margin, width + 2.0f * margin, height + 2.0f * margin},
+			sfColor_fromRGBA(0, 0, 0, 180));
+	debugTextAppend(profilerVertices, text, (sfVector2f) {2.0f * margin, 2.0f * margin}, pixelSize, sfWhite);
+
+	sfView *boardView = sfView_copy(sfRenderWindow_getView(window));
+	sfRenderWindow_setView(window, sfRenderWindow_getDefaultView(window));
+	sfRenderWindow_drawVertexArray(window, profilerVertices, NULL);
+	sfRenderWindow_setView(window, boardView);
+	sfView_destroy(boardView);
 }
 
-void drawCircleShape(sfCircleShape *shape, sq s)
+void buildAnalysisVertices()
 {
-	uint8_t file = s.file;
-	uint8_t rank = s.rank;
+	sfVertexArray_clear(analysisVertices);
 
-	if (isFlipped)
+	float boardSize = SQUARE_SIZE * 8.0f;
+	float barX = boardSize + ANALYSIS_MARGIN;
+
+	// Scores are turned into how full the bar is the same way Elo differences are turned into expected scores, so it
+	// moves a lot for small advantages and hardly at all once the game is decided
+	float whiteShare = 0.5f;
+	if (analysis.numLines > 0)
 	{
-		file = 9 - file;
-		rank = 9 - rank;
+		int score = analysis.lines[0].score;
+		if (analysis.player == pcBlack)
+			score = -score;
+
+		if (score >= SCORE_MATE_BOUND)
+			whiteShare = 1.0f;
+		else if (score <= -SCORE_MATE_BOUND)
+			whiteShare = 0.0f;
+		else
+			whiteShare = 1.0f / (1.0f + powf(10.0f, -score / 400.0f));
 	}
 
-	sfCircleShape_setPosition(shape, (sfVector2f) {((float) file - 0.5) * SQUARE_SIZE, (8.5 - (float) rank) * SQUARE_SIZE});
-	sfRenderWindow_drawCircleShape(window, shape, NULL);
+	// White's part of the bar is on white's side of the board
+	float whiteHeight = boardSize * whiteShare;
+	float whiteY = isFlipped ? 0.0f : boardSize - whiteHeight;
+	appendRect(analysisVertices, (sfFloatRect) {barX, 0.0f, ANALYSIS_BAR_WIDTH, boardSize}, sfColor_fromRGB(40, 40, 40));
+	appendRect(analysisVertices, (sfFloatRect) {barX, whiteY, ANALYSIS_BAR_WIDTH, whiteHeight},
+			sfColor_fromRGB(230, 230, 230));
+
+	char text[512];
+	int length = sprintf(text, "depth %d\n", analysis.depth);
+	for (int i = 0; i < analysis.numLines; i++)
+	{
+		const searchLine *line = &analysis.lines[i];
+
+		// Shown from white's point of view, like the bar
+		int score = analysis.player == pcWhite ? line->score : -line->score;
+		if (score >= SCORE_MATE_BOUND || score <= -SCORE_MATE_BOUND)
+			length += sprintf(text + length, "%sM%d", score > 0 ? "+" : "-", (SCORE_MATE - abs(score) + 1) / 2);
+		else
+			length += sprintf(text + length, "%+.2f", score / 100.0f);
+
+		for (int j = 0; j < line->length && j < ANALYSIS_PV_SHOWN; j++)
+		{
+			text[length++] = ' ';
+			notationMoveToUci(line->moves[j], text + length);
+			length += strlen(text + length);
+		}
+		text[length++] = '\n';
+	}
+	text[length] = '\0';
+
+	sfVector2f textPosition = {barX + ANALYSIS_BAR_WIDTH + ANALYSIS_MARGIN, 0.0f};
+	debugTextAppend(analysisVertices, text, textPosition, ANALYSIS_TEXT_SIZE, sfWhite);
 }
 
-sfTexture *getPieceTex(piece p)
+int getPieceSetIndex(piece p)
 {
 	switch (p)
 	{
 		case pWPawn:
-			return currentPieceSet->wP;
+			return 0;
 		case pWKnight:
-			return currentPieceSet->wN;
+			return 1;
 		case pWBishop:
-			return currentPieceSet->wB;
+			return 2;
 		case pWRook:
-			return currentPieceSet->wR;
+			return 3;
 		case pWQueen:
-			return currentPieceSet->wQ;
+			return 4;
 		case pWKing:
-			return currentPieceSet->wK;
+			return 5;
 		case pBPawn:
-			return currentPieceSet->bP;
+			return 6;
 		case pBKnight:
-			return currentPieceSet->bN;
+			return 7;
 		case pBBishop:
-			return currentPieceSet->bB;
+			return 8;
 		case pBRook:
-			return currentPieceSet->bR;
+			return 9;
 		case pBQueen:
-			return currentPieceSet->bQ;
+			return 10;
 		case pBKing:
-			return currentPieceSet->bK;
+			return 11;
 		default:
-			return NULL;
+			return -1;
 	}
 }
 
+sfIntRect getPieceTexRect(const pieceSet *ps, piece p)
+{
+	int index = getPieceSetIndex(p);
+	if (index < 0)
+		return (sfIntRect) {0, 0, 0, 0};
+
+	int stride = ps->pieceSize + PIECE_ATLAS_PADDING;
+	return (sfIntRect) {(index % 6) * stride, (index / 6) * stride, ps->pieceSize, ps->pieceSize};
+}
+
 // This sets the values at the pointers to the correct file and rank.
 // Returns true if position is inside board, false otherwise
 int getMouseSquare(int mouseX, int mouseY, sq *s)
@@ -715,14 +1256,20 @@ void initChess()
 		chessFree(g);
 
 	g = chessCreateFen(initialFen);
+	keyHistoryReset(&gameKeys, g);
+	aiResetClock(&aiCtx);
+	aiWorkerNewGame(initialFen);
 
 	updateGameState();
 }
 
 void updateWindowTitle()
 {
+	int64_t start = profileBegin();
+
 	char message[155];
 	char *fen = chessGetFen(g);
+	int repetitions;
 	if (chessGetTerminalState(g) != tsOngoing)
 	{
 		char termMessage[40];
@@ -754,9 +1301,9 @@ void updateWindowTitle()
 		}
 		sprintf(message, "%s   %s", termMessage, fen);
 	}
-	else if (chessGetRepetitions(g) != 1)
+	else if ((repetitions = keyHistoryRepetitions(&gameKeys, chessGetBoard(g)->halfMoveClock)) != 1)
 	{
-		sprintf(message, "Repetitions: %d   %s", chessGetRepetitions(g), fen);
+		sprintf(message, "Repetitions: %d   %s", repetitions, fen);
 	}
 	else
 	{
@@ -764,24 +1311,21 @@ void updateWindowTitle()
 	}
 	sfRenderWindow_setTitle(window, message);
 	free(fen);
+
+	profileEnd(pzWindowTitle, start);
 }
 
 void updateGameState()
 {
 	updateWindowTitle();
 
-	if (chessGetMoveHistory(g)->tail == NULL)
-	{
-		highlight1Sq = SQ_INVALID;
-		highlight2Sq = SQ_INVALID;
-	}
-	else
-	{
-		move m = chessGetMoveHistory(g)->tail->move;
+	renderSnapshot *next = snapshot == &snapshots[0] ? &snapshots[1] : &snapshots[0];
+	buildRenderSnapshot(next);
+	snapshot = next;
+	boardDirty = 1;
 
-		highlight1Sq = m.from;
-		highlight2Sq = m.to;
-	}
+	if (showAnalysis)
+		analysisStart(g);
 
 	if (chessGetTerminalState(g) == tsOngoing)
 	{
@@ -790,114 +1334,112 @@ void updateGameState()
 	}
 }
 
-// Returns the squares that can be reached by a legal move from the given starting square
-sqSet getLegalSquareSet(sq s)
+int getSquareIndex(sq s)
 {
-	sqSet ss = 0;
-
-	for (moveListNode *n = chessGetLegalMoves(g)->head; n; n = n->next)
-	{
-		move m = n->move;
-		if (sqEq(m.from, s))
-			sqSetSet(&ss, m.to, 1);
-	}
-
-	return ss;
-}
-
-/////////////////////////////
-// DIFFERENT AI STRATEGIES //
-/////////////////////////////
-
-// TODO - make it so that the player can choose which AI to play against
-
-// Strategy: PICK RANDOM MOVE
-move aiRandomMove()
-{
-	moveList *list = chessGetLegalMoves(g);
-	int randIndex = rand() % list->size;
-
-	moveListNode *n = list->head;
-	for (int i = 0; i < randIndex; i++)
-		n = n->next;
-
-	return n->move;
+	return 8 * (s.rank - 1) + (s.file - 1);
 }
 
-// Strategy: MINIMIZE OPPONENTS MOVES
-// It will play a random move such that the number of responses is minimized
-move aiMinOpponentMoves()
+void buildRenderSnapshot(renderSnapshot *rs)
 {
-	moveList *list = chessGetLegalMoves(g);
-	int size = list->size;
-	int *responses = (int *) malloc(size * sizeof(int));
+	int64_t queryStart = profileBegin();
 
-	// Figure out how many responses each move will let the opponent have
-	board scratchBoard;
-	for (int i = 0; i < size; i++)
+	rs->checkSq = SQ_INVALID;
+	for (int i = 0; i < 64; i++)
 	{
-		memcpy(&scratchBoard, chessGetBoard(g), sizeof(board));
-
-		move m = moveListGet(list, i);
-		boardPlayMoveInPlace(&scratchBoard, m);
-		moveList *newList = boardGenerateMoves(&scratchBoard);
+		sq s;
+		s.file = (i % 8) + 1;
+		s.rank = (i / 8) + 1;
 
-		responses[i] = newList->size;
-
-		moveListFree(newList);
+		rs->pieces[i] = chessGetPiece(g, s);
+		if (pieceGetType(rs->pieces[i]) == ptKing && chessIsSquareAttacked(g, s))
+			rs->checkSq = s;
 	}
 
-	// Determine what the number of least responses and how many there are
-	int leastResponses = 1000000;
-	int leastResponsesCount = 0;
+	profileEnd(pzBoardQueries, queryStart);
 
-	for (int i = 0; i < size; i++)
+	if (chessGetMoveHistory(g)->tail == NULL)
 	{
-		if (responses[i] < leastResponses)
-		{
-			leastResponses = responses[i];
-			leastResponsesCount = 1;
-		}
-		else if (responses[i] == leastResponses)
-		{
-			leastResponsesCount++;
-		}
+		rs->highlight1Sq = SQ_INVALID;
+		rs->highlight2Sq = SQ_INVALID;
 	}
+	else
+	{
+		move m = chessGetMoveHistory(g)->tail->move;
 
-	// Now that we know how many, pick a random move out of those moves
-	int randIndex = rand() % leastResponsesCount;
+		rs->highlight1Sq = m.from;
+		rs->highlight2Sq = m.to;
+	}
 
-	// Move to the first move with the least number of responses
-	int moveIndex = 0;
-	while (responses[moveIndex] > leastResponses)
-		moveIndex++;
+	memset(rs->legalFrom, 0, sizeof(rs->legalFrom));
 
-	// Move to the next index where the random move is
-	for (int i = 0; i < randIndex; i++)
-	{
-		moveIndex++;
+	// Nothing can move once the game is over, including after a draw has been claimed
+	if (chessGetTerminalState(g) != tsOngoing)
+		return;
 
-		while (responses[moveIndex] > leastResponses)
-			moveIndex++;
+	for (moveListNode *n = chessGetLegalMoves(g)->head; n; n = n->next)
+	{
+		move m = n->move;
+		sqSetSet(&rs->legalFrom[getSquareIndex(m.from)], m.to, 1);
 	}
+}
+
+// Returns the squares that can be reached by a legal move from the given starting square
+sqSet getLegalSquareSet(sq s)
+{
+	return snapshot->legalFrom[getSquareIndex(s)];
+}
+
+void playMoveSound(int isCapture, int isCheck)
+{
+	if (!playSound)
+		return;
 
-	free(responses);
+	if (isCapture)
+		sfSound_play(sndCapture);
+	else
+		sfSound_play(sndMove);
 
-	// Play the given move
-	return moveListGet(list, moveIndex);
+	if (chessGetTerminalState(g) != tsOngoing)
+		sfSound_play(sndTerminal);
+	else if (isCheck)
+		sfSound_play(sndCheck);
 }
 
-// This is the function which determines which strategy the AI will use
-move aiGetMove()
+move getDraggedMove(sq s)
 {
-	return aiRandomMove();
+	move m = moveSq(draggingSq, s);
+	if (pieceGetType(chessGetPiece(g, draggingSq)) == ptPawn && (s.rank == 1 || s.rank == 8))
+		m.promotion = ptQueen;
+	return m;
 }
 
-void playAiMove()
+void playAiMove(move m)
 {
 	if (chessGetTerminalState(g) != tsOngoing)
 		return;
 
-	move m = aiGetMove();
-	chessPlayMove(g, m);
+	board *aiBoard = chessGetBoard(g);
+
+	uint8_t isCapture = boardGetPiece(aiBoard, m.to) ||
+			(pieceGetType(boardGetPiece(aiBoard, m.from)) == ptPawn && m.to.file != m.from.file);
+
+	if (keyHistoryPlayMove(&gameKeys, g, m))
+		return;
+
+	playMoveSound(isCapture, chessIsInCheck(g));
+
+	updateGameState();
+}
+
+const aiStrategy *findStrategyArg(const char *name)
+{
+	const aiStrategy *strategy = aiFindStrategy(name);
+	if (strategy)
+		return strategy;
+
+	fprintf(stderr, "ERROR: Unknown strategy \"%s\". Available strategies are:", name);
+	for (int i = 0; i < aiStrategyCount; i++)
+		fprintf(stderr, " %s", aiStrategies[i].name);
+	fprintf(stderr, "\n");
+	return NULL;
 }
@@ -4,36 +4,83 @@
  */
 
 #include <SFML/Graphics.h>
+#include <SFML/Audio.h>
 
 #include "chesslib/piece.h"
 
+#include "ai.h"
+
+// A piece set is a single texture atlas holding all twelve pieces, white on the top row and black on the bottom, so
+// every piece on the board can be drawn in one batch
 typedef struct
 {
-	sfTexture *wP;
-	sfTexture *wN;
-	sfTexture *wB;
-	sfTexture *wR;
-	sfTexture *wQ;
-	sfTexture *wK;
-	sfTexture *bP;
-	sfTexture *bN;
-	sfTexture *bB;
-	sfTexture *bR;
-	sfTexture *bQ;
-	sfTexture *bK;
+	const char *name;
+	sfTexture *atlas; 	// NULL until the set is first used
+	unsigned int pieceSize;
 } pieceSet;
 
+#define PIECE_SET_SIZE 12
+#define SOUND_COUNT 4
+
+// Files to decode in one go on the asset pool. Only decoding happens there, since the textures can only be created on
+// the thread that owns the window's GL context
+typedef struct
+{
+	const pieceSet *ps; 	// NULL to skip the pieces
+	sfImage *pieceImages[PIECE_SET_SIZE];
+	int loadSounds;
+	sfSoundBuffer *soundBuffers[SOUND_COUNT];
+} assetBatch;
+
+// Everything drawn about the game, copied out of it whenever it changes. The renderer only reads snapshots, so drawing
+// a frame never calls into chesslib and is safe while a worker thread is using the game
+typedef struct
+{
+	piece pieces[64]; 	// Indexed by getSquareIndex
+	sq checkSq; 	// The king in check, or SQ_INVALID
+	sq highlight1Sq;
+	sq highlight2Sq;
+	sqSet legalFrom[64]; 	// For every square, the squares its piece can legally move to
+} renderSnapshot;
+
 int main(int argc, char *argv[]);
 
-void loadPieceSet(pieceSet *ps, const char *name);
+// Decodes every file in the batch, spread over the asset pool
+void loadAssets(assetBatch *batch);
+void loadAssetTask(void *userData, int workerIndex, int taskIndex);
+
+// Uploads a batch's decoded pieces as the set's atlas and frees the images
+void buildPieceSet(pieceSet *ps, assetBatch *batch);
+
+// Loads a piece set that hasn't been used yet, then makes it the current one
+void selectPieceSet(pieceSet *ps);
 void destroyPieceSet(pieceSet *ps);
 
 void calcView();
 void drawPiece(piece p, sfVector2f coords);
-void drawBoardPiece(piece p, sq s);
-void drawCircleShape(sfCircleShape *shape, sq s);
 
-sfTexture *getPieceTex(piece p);
+// Returns the center of a square in view coordinates, taking board flipping into account
+sfVector2f getSquareCenter(sq s);
+
+// Appends geometry to a vertex array of triangles. An empty texRect leaves the quad untextured
+void appendQuad(sfVertexArray *va, sfVector2f center, float size, sfColor color, sfIntRect texRect);
+void appendRect(sfVertexArray *va, sfFloatRect rect, sfColor color);
+void appendCircle(sfVertexArray *va, sfVector2f center, float radius, sfColor color);
+
+// Rebuilds the board, piece and overlay vertex arrays from the current snapshot and display state
+void buildBoardVertices();
+
+// Draws the profiler's timings in the top left corner of the window
+void drawProfilerOverlay();
+
+// Builds the analysis panel beside the board from the latest results: an evaluation bar, the depth and the best lines
+void buildAnalysisVertices();
+
+// Index of a piece's cell within a pieceSet atlas, or -1 for an empty square
+int getPieceSetIndex(piece p);
+
+// Returns the area of a piece set's atlas holding the given piece
+sfIntRect getPieceTexRect(const pieceSet *ps, piece p);
 
 // This sets the values at the pointers to the correct file and rank.
 // Returns true if position is inside board, false otherwise
@@ -43,8 +90,22 @@ void initChess();
 void updateWindowTitle();
 void updateGameState();
 
+// Index of a square in 0-63 order, a1 first
+int getSquareIndex(sq s);
+
+// Copies everything the renderer needs out of the current game. Called by updateGameState whenever the game changes
+void buildRenderSnapshot(renderSnapshot *rs);
+
 // Returns the squares that can be reached by a legal move from the given starting square
 sqSet getLegalSquareSet(sq s);
 
-move aiGetMove();
-void playAiMove();
+void playMoveSound(int isCapture, int isCheck);
+
+// The move made by dropping the dragged piece on s. Pawns always promote to queens
+move getDraggedMove(sq s);
+
+// Plays a move chosen by the bot on the main game, with sound
+void playAiMove(move m);
+
+// Looks up a strategy named on the command line. Prints the available ones and returns NULL if there isn't one
+const aiStrategy *findStrategyArg(const char *name);
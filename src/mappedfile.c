@@ -0,0 +1,91 @@
+/*
+ * Memory mapped file implementation
+ */
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "mappedfile.h"
+
+int mappedFileOpen(mappedFile *f, const char *path)
+{
+	f->data = NULL;
+	f->size = 0;
+
+#ifdef _WIN32
+	f->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (f->file == INVALID_HANDLE_VALUE)
+		return 0;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(f->file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(f->file);
+		return 0;
+	}
+
+	f->mapping = CreateFileMappingA(f->file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (!f->mapping)
+	{
+		CloseHandle(f->file);
+		return 0;
+	}
+
+	f->data = (const uint8_t *) MapViewOfFile(f->mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!f->data)
+	{
+		CloseHandle(f->mapping);
+		CloseHandle(f->file);
+		return 0;
+	}
+
+	f->size = (size_t) size.QuadPart;
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return 0;
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size == 0)
+	{
+		close(fd);
+		return 0;
+	}
+
+	void *data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+	// The mapping keeps its own reference to the file
+	close(fd);
+
+	if (data == MAP_FAILED)
+		return 0;
+
+	f->data = (const uint8_t *) data;
+	f->size = (size_t) st.st_size;
+#endif
+
+	return 1;
+}
+
+void mappedFileClose(mappedFile *f)
+{
+	if (!f->data)
+		return;
+
+#ifdef _WIN32
+	UnmapViewOfFile(f->data);
+	CloseHandle(f->mapping);
+	CloseHandle(f->file);
+#else
+	munmap((void *) f->data, f->size);
+#endif
+
+	f->data = NULL;
+	f->size = 0;
+}
@@ -0,0 +1,28 @@
+/*
+ * Memory mapped file declarations
+ */
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// A whole file mapped read-only into memory. The OS pages it in as it is touched and can drop the pages again under
+// memory pressure, so even very large files cost nothing until they are read
+typedef struct
+{
+	const uint8_t *data;
+	size_t size;
+
+#ifdef _WIN32
+	void *file;
+	void *mapping;
+#endif
+} mappedFile;
+
+// Returns false if the file can't be opened or mapped. Empty files can't be mapped
+int mappedFileOpen(mappedFile *f, const char *path);
+void mappedFileClose(mappedFile *f);
+
+#endif
@@ -0,0 +1,338 @@
+/*
+ * Headless strategy-vs-strategy match implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <SFML/System.h>
+
+#include "chesslib/chess.h"
+
+#include "match.h"
+#include "threadpool.h"
+
+// Long enough for any FEN or EPD line worth reading
+#define MATCH_LINE_LENGTH 512
+
+// Owned by one worker thread, merged after all games are finished. Results are from the point of view of strategy a
+typedef struct
+{
+	aiContext ctx[2];
+	sfClock *clock;
+	int wins;
+	int draws;
+	int losses;
+	double sumSquaredScores;
+	unsigned long long moves[2];
+	double seconds[2];
+} matchWorker;
+
+typedef struct
+{
+	const aiStrategy *strategies[2];
+	char **openings;
+	int numOpenings;
+	uint64_t seed;
+	matchWorker *workers;
+} matchJob;
+
+static void matchGame(void *userData, int workerIndex, int gameIndex)
+{
+	matchJob *job = (matchJob *) userData;
+	matchWorker *w = &job->workers[workerIndex];
+
+	// Each opening is played twice in a row with the colors swapped, so neither strategy gets the better side of it
+	const char *fen = job->openings[(gameIndex / 2) % job->numOpenings];
+	pieceColor aColor = gameIndex % 2 == 0 ? pcWhite : pcBlack;
+
+	// Seed per game rather than per thread, so that a given seed plays the same games for any thread count
+	aiNewGame(&w->ctx[0], job->seed + 2 * (uint64_t) gameIndex);
+	aiNewGame(&w->ctx[1], job->seed + 2 * (uint64_t) gameIndex + 1);
+
+	chess *c = chessCreateFen(fen);
+
+	while (chessGetTerminalState(c) == tsOngoing)
+	{
+		int side = chessGetPlayer(c) == aColor ? 0 : 1;
+
+		sfClock_restart(w->clock);
+		move m = aiGetMoveWith(&w->ctx[side], c, job->strategies[side]);
+		w->seconds[side] += sfTime_asSeconds(sfClock_getElapsedTime(w->clock));
+		w->moves[side]++;
+
+		chessPlayMove(c, m);
+	}
+
+	double score = 0.5;
+	if (chessGetTerminalState(c) == tsCheckmate)
+	{
+		// The side to move is the one which got mated
+		if (chessGetPlayer(c) == aColor)
+		{
+			w->losses++;
+			score = 0.0;
+		}
+		else
+		{
+			w->wins++;
+			score = 1.0;
+		}
+	}
+	else
+	{
+		w->draws++;
+	}
+	w->sumSquaredScores += score * score;
+
+	chessFree(c);
+}
+
+// Turns an EPD line into a FEN by keeping its four position fields and adding move counters. A full FEN is kept as is
+static char *matchParseOpening(char *line)
+{
+	line[strcspn(line, "\r\n")] = '\0';
+
+	char *start = line;
+	while (*start == ' ' || *start == '\t')
+		start++;
+
+	if (*start == '\0' || *start == '#')
+		return NULL;
+
+	// Find the end of the fourth field
+	char *end = start;
+	for (int field = 0; field < 4 && *end; field++)
+	{
+		while (*end == ' ' || *end == '\t')
+			end++;
+		while (*end && *end != ' ' && *end != '\t')
+			end++;
+	}
+
+	// If the fifth and sixth fields are the move counters, this is already a FEN
+	int halfMoves, fullMoves;
+	char trailing;
+	if (sscanf(end, "%d %d %c", &halfMoves, &fullMoves, &trailing) == 2)
+	{
+		char *fen = (char *) malloc(strlen(start) + 1);
+		strcpy(fen, start);
+		return fen;
+	}
+
+	size_t length = end - start;
+	char *fen = (char *) malloc(length + 5);
+	memcpy(fen, start, length);
+	strcpy(fen + length, " 0 1");
+	return fen;
+}
+
+static char **matchLoadOpenings(const char *path, int *numOpenings)
+{
+	FILE *f = fopen(path, "r");
+	if (!f)
+	{
+		fprintf(stderr, "ERROR: Unable to open openings file %s\n", path);
+		return NULL;
+	}
+
+	char **openings = NULL;
+	int count = 0;
+	int lineNumber = 0;
+	char line[MATCH_LINE_LENGTH];
+
+	while (fgets(line, sizeof(line), f))
+	{
+		lineNumber++;
+
+		char *fen = matchParseOpening(line);
+		if (!fen)
+			continue;
+
+		// Check every position now, rather than have a worker thread find out halfway through the match
+		chess *c = chessCreateFen(fen);
+		if (!c)
+		{
+			fprintf(stderr, "ERROR: Invalid position on line %d of openings file %s: %s\n", lineNumber, path, fen);
+			free(fen);
+			for (int i = 0; i < count; i++)
+				free(openings[i]);
+			free(openings);
+			fclose(f);
+			return NULL;
+		}
+		chessFree(c);
+
+		openings = (char **) realloc(openings, (count + 1) * sizeof(char *));
+		openings[count++] = fen;
+	}
+
+	fclose(f);
+
+	if (count == 0)
+	{
+		fprintf(stderr, "ERROR: No positions found in openings file %s\n", path);
+		free(openings);
+		return NULL;
+	}
+
+	*numOpenings = count;
+	return openings;
+}
+
+// The Elo difference which makes the expected score s
+static double matchElo(double s)
+{
+	return -400.0 * log10(1.0 / s - 1.0);
+}
+
+static void printElo(double elo)
+{
+	if (isinf(elo) || isnan(elo))
+		printf("%s", elo < 0 ? "-inf" : "+inf");
+	else
+		printf("%+.1f", elo);
+}
+
+static void printTimePerMove(const aiStrategy *s, unsigned long long moves, double seconds)
+{
+	printf("  %-14s %8.3f ms/move  (%llu moves)\n", s->name, moves ? 1000.0 * seconds / moves : 0.0, moves);
+}
+
+int matchRun(const aiStrategy *a, const aiStrategy *b, int numGames, int numThreads, const char *openingsPath,
+		const char *fen, uint64_t seed)
+{
+	if (numGames <= 0)
+	{
+		fprintf(stderr, "ERROR: The number of match games must be positive\n");
+		return 1;
+	}
+
+	matchJob job;
+	job.strategies[0] = a;
+	job.strategies[1] = b;
+	job.seed = seed;
+
+	if (openingsPath)
+	{
+		job.openings = matchLoadOpenings(openingsPath, &job.numOpenings);
+		if (!job.openings)
+			return 1;
+	}
+	else
+	{
+		chess *c = chessCreateFen(fen);
+		if (!c)
+		{
+			fprintf(stderr, "ERROR: Invalid FEN \"%s\"\n", fen);
+			return 1;
+		}
+		chessFree(c);
+
+		job.openings = (char **) malloc(sizeof(char *));
+		job.openings[0] = (char *) malloc(strlen(fen) + 1);
+		strcpy(job.openings[0], fen);
+		job.numOpenings = 1;
+	}
+
+	if (numThreads <= 0)
+		numThreads = threadPoolGetCpuCount();
+	if (numThreads > numGames)
+		numThreads = numGames;
+
+	threadPool *pool = threadPoolCreate(numThreads);
+
+	job.workers = (matchWorker *) calloc(numThreads, sizeof(matchWorker));
+	for (int i = 0; i < numThreads; i++)
+	{
+		aiInit(&job.workers[i].ctx[0], seed);
+		aiInit(&job.workers[i].ctx[1], seed);
+		job.workers[i].clock = sfClock_create();
+	}
+
+	printf("Playing %d games of %s vs %s from %d opening%s on %d threads (seed %llu)\n", numGames, a->name, b->name,
+			job.numOpenings, job.numOpenings == 1 ? "" : "s", numThreads, (unsigned long long) seed);
+	fflush(stdout);
+
+	sfClock *clock = sfClock_create();
+
+	threadPoolRun(pool, matchGame, &job, numGames);
+
+	float seconds = sfTime_asSeconds(sfClock_getElapsedTime(clock));
+	sfClock_destroy(clock);
+
+	// Merge the per-worker tallies
+	int wins = 0;
+	int draws = 0;
+	int losses = 0;
+	double sumSquaredScores = 0.0;
+	unsigned long long moves[2] = {0, 0};
+	double moveSeconds[2] = {0.0, 0.0};
+
+	for (int i = 0; i < numThreads; i++)
+	{
+		matchWorker *w = &job.workers[i];
+
+		wins += w->wins;
+		draws += w->draws;
+		losses += w->losses;
+		sumSquaredScores += w->sumSquaredScores;
+		for (int j = 0; j < 2; j++)
+		{
+			moves[j] += w->moves[j];
+			moveSeconds[j] += w->seconds[j];
+			aiFree(&w->ctx[j]);
+		}
+
+		sfClock_destroy(w->clock);
+	}
+
+	free(job.workers);
+	threadPoolFree(pool);
+
+	for (int i = 0; i < job.numOpenings; i++)
+		free(job.openings[i]);
+	free(job.openings);
+
+	// 95% confidence interval of the score, from the spread of the individual game results
+	double score = (wins + 0.5 * draws) / numGames;
+	double variance = sumSquaredScores / numGames - score * score;
+	double margin = 1.96 * sqrt(variance / numGames);
+
+	double elo = matchElo(score);
+	double eloLow = matchElo(score - margin < 0.0 ? 0.0 : score - margin);
+	double eloHigh = matchElo(score + margin > 1.0 ? 1.0 : score + margin);
+
+	printf("Finished in %.3f s\n", seconds);
+	printf("Results for %s:\n", a->name);
+	printf("  %-14s %d / %d / %d\n", "W / D / L", wins, draws, losses);
+	printf("  %-14s %5.1f%%\n", "Score", 100.0 * score);
+	printf("  %-14s ", "Elo difference");
+	if (losses == 0 && draws == 0)
+	{
+		// A perfect score has no finite estimate. What can be said is that a win chance p with p^numGames < 5% would
+		// hardly ever win every game, so the difference is at least the Elo of the p where that is exactly 5%
+		printf("above %+.1f (95%% confidence, every game was won)", matchElo(pow(0.05, 1.0 / numGames)));
+	}
+	else if (wins == 0 && draws == 0)
+	{
+		printf("below %+.1f (95%% confidence, every game was lost)", -matchElo(pow(0.05, 1.0 / numGames)));
+	}
+	else
+	{
+		printElo(elo);
+		printf(" (95%% CI ");
+		printElo(eloLow);
+		printf(" to ");
+		printElo(eloHigh);
+		printf(")");
+	}
+	printf("\n");
+	printf("Time per move:\n");
+	printTimePerMove(a, moves[0], moveSeconds[0]);
+	printTimePerMove(b, moves[1], moveSeconds[1]);
+
+	return 0;
+}
@@ -0,0 +1,21 @@
+/*
+ * Headless strategy-vs-strategy match declarations
+ */
+
+#ifndef MATCH_H
+#define MATCH_H
+
+#include <stdint.h>
+
+#include "ai.h"
+
+#define MATCH_DEFAULT_GAMES 100
+
+// Plays numGames games of strategy a against strategy b, spread over numThreads worker threads, and prints a's score,
+// the Elo difference it implies and how long each strategy spent per move. Each opening is played twice, once with
+// each strategy as white. Openings are read from openingsPath, one FEN or EPD position per line. If openingsPath is
+// NULL, every game starts from fen. If numThreads is 0, one thread per core is used. Returns the process exit code
+int matchRun(const aiStrategy *a, const aiStrategy *b, int numGames, int numThreads, const char *openingsPath,
+		const char *fen, uint64_t seed);
+
+#endif
@@ -0,0 +1,288 @@
+/*
+ * Move buffer implementation
+ */
+
+#include "movebuffer.h"
+
+// Bits of castleState, the same ones zobrist.c hashes
+#define CASTLE_WHITE_SHORT 0x8
+#define CASTLE_WHITE_LONG 0x4
+#define CASTLE_BLACK_SHORT 0x2
+#define CASTLE_BLACK_LONG 0x1
+
+static const int knightSteps[8][2] = {{1, 2}, {2, 1}, {2, -1}, {1, -2}, {-1, -2}, {-2, -1}, {-2, 1}, {-1, 2}};
+static const int kingSteps[8][2] = {{1, 0}, {1, 1}, {0, 1}, {-1, 1}, {-1, 0}, {-1, -1}, {0, -1}, {1, -1}};
+static const int rookDirections[4][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+static const int bishopDirections[4][2] = {{1, 1}, {-1, 1}, {-1, -1}, {1, -1}};
+
+static const pieceType promotions[4] = {ptQueen, ptRook, ptBishop, ptKnight};
+
+void moveBufferFromList(moveBuffer *buf, moveList *list)
+{
+	buf->size = 0;
+
+	for (moveListNode *n = list->head; n && buf->size < MOVE_BUFFER_CAPACITY; n = n->next)
+		buf->moves[buf->size++] = n->move;
+}
+
+static int moveBufferOnBoard(int file, int rank)
+{
+	return file >= 1 && file <= 8 && rank >= 1 && rank <= 8;
+}
+
+static int moveBufferIsPiece(board *b, int file, int rank, pieceColor color, pieceType type)
+{
+	if (!moveBufferOnBoard(file, rank))
+		return 0;
+
+	piece p = boardGetPiece(b, (sq) {file, rank});
+	return p != pEmpty && pieceGetColor(p) == color && pieceGetType(p) == type;
+}
+
+// Returns true if the first piece from the square in the given direction belongs to the attacker, and is either of the
+// given type or a queen
+static int moveBufferIsSlidingAttack(board *b, sq s, const int direction[2], pieceColor by, pieceType type)
+{
+	int file = s.file + direction[0];
+	int rank = s.rank + direction[1];
+
+	while (moveBufferOnBoard(file, rank))
+	{
+		piece p = boardGetPiece(b, (sq) {file, rank});
+		if (p != pEmpty)
+			return pieceGetColor(p) == by && (pieceGetType(p) == type || pieceGetType(p) == ptQueen);
+
+		file += direction[0];
+		rank += direction[1];
+	}
+
+	return 0;
+}
+
+static int moveBufferIsAttacked(board *b, sq s, pieceColor by)
+{
+	// Pawns capture forwards, so an attacking pawn stands one rank behind the square from its own point of view
+	int pawnRank = s.rank + (by == pcWhite ? -1 : 1);
+	if (moveBufferIsPiece(b, s.file - 1, pawnRank, by, ptPawn) || moveBufferIsPiece(b, s.file + 1, pawnRank, by, ptPawn))
+		return 1;
+
+	for (int i = 0; i < 8; i++)
+	{
+		if (moveBufferIsPiece(b, s.file + knightSteps[i][0], s.rank + knightSteps[i][1], by, ptKnight) ||
+				moveBufferIsPiece(b, s.file + kingSteps[i][0], s.rank + kingSteps[i][1], by, ptKing))
+			return 1;
+	}
+
+	for (int i = 0; i < 4; i++)
+	{
+		if (moveBufferIsSlidingAttack(b, s, rookDirections[i], by, ptRook) ||
+				moveBufferIsSlidingAttack(b, s, bishopDirections[i], by, ptBishop))
+			return 1;
+	}
+
+	return 0;
+}
+
+// What every generator function needs to know about the position
+typedef struct
+{
+	moveBuffer *buf;
+	board *b;
+	sq king;
+	int inCheck;
+} moveGenerator;
+
+// Adds the move unless it leaves the mover's king, which ends up on the given square, in check. Playing the move out is
+// only needed when it could expose the king: when the king moves or is already in check, for en passant, and for a
+// piece standing on a line from the king, which might be pinned
+static void moveBufferAdd(moveGenerator *gen, move m, sq king, int mustCheck)
+{
+	if (gen->buf->size >= MOVE_BUFFER_CAPACITY)
+		return;
+
+	int fileDistance = m.from.file - king.file;
+	int rankDistance = m.from.rank - king.rank;
+	int aligned = fileDistance == 0 || rankDistance == 0 || fileDistance == rankDistance ||
+			fileDistance == -rankDistance;
+
+	if (king.file != 0 && (mustCheck || gen->inCheck || aligned))
+	{
+		board after = *gen->b;
+		boardPlayMoveInPlace(&after, m);
+
+		if (moveBufferIsAttacked(&after, king, gen->b->currentPlayer == pcWhite ? pcBlack : pcWhite))
+			return;
+	}
+
+	gen->buf->moves[gen->buf->size++] = m;
+}
+
+static void moveBufferAddPawnMove(moveGenerator *gen, sq from, sq to, int enPassant)
+{
+	move m = moveSq(from, to);
+
+	if (to.rank != 1 && to.rank != 8)
+	{
+		moveBufferAdd(gen, m, gen->king, enPassant);
+		return;
+	}
+
+	for (int i = 0; i < 4; i++)
+	{
+		m.promotion = promotions[i];
+		moveBufferAdd(gen, m, gen->king, 0);
+	}
+}
+
+static void moveBufferGeneratePawn(moveGenerator *gen, sq from)
+{
+	board *b = gen->b;
+	pieceColor us = b->currentPlayer;
+	int forward = us == pcWhite ? 1 : -1;
+	int startRank = us == pcWhite ? 2 : 7;
+
+	sq one = {from.file, from.rank + forward};
+	if (boardGetPiece(b, one) == pEmpty)
+	{
+		moveBufferAddPawnMove(gen, from, one, 0);
+
+		sq two = {from.file, from.rank + 2 * forward};
+		if (from.rank == startRank && boardGetPiece(b, two) == pEmpty)
+			moveBufferAddPawnMove(gen, from, two, 0);
+	}
+
+	for (int side = -1; side <= 1; side += 2)
+	{
+		int file = from.file + side;
+		if (file < 1 || file > 8)
+			continue;
+
+		sq to = {file, from.rank + forward};
+		piece target = boardGetPiece(b, to);
+
+		if (target != pEmpty && pieceGetColor(target) != us)
+			moveBufferAddPawnMove(gen, from, to, 0);
+		else if (target == pEmpty && sqEq(to, b->epTarget))
+			moveBufferAddPawnMove(gen, from, to, 1);
+	}
+}
+
+// Knights and kings step to a fixed set of squares, everything else slides until it hits something. A moving king is
+// the one which has to be safe afterwards
+static void moveBufferGeneratePiece(moveGenerator *gen, sq from, const int steps[][2], int numSteps, int sliding,
+		int isKing)
+{
+	pieceColor us = gen->b->currentPlayer;
+
+	for (int i = 0; i < numSteps; i++)
+	{
+		int file = from.file + steps[i][0];
+		int rank = from.rank + steps[i][1];
+
+		while (moveBufferOnBoard(file, rank))
+		{
+			sq to = {file, rank};
+			piece target = boardGetPiece(gen->b, to);
+
+			if (target != pEmpty && pieceGetColor(target) == us)
+				break;
+
+			moveBufferAdd(gen, moveSq(from, to), isKing ? to : gen->king, isKing);
+
+			if (target != pEmpty || !sliding)
+				break;
+
+			file += steps[i][0];
+			rank += steps[i][1];
+		}
+	}
+}
+
+static void moveBufferGenerateCastling(moveGenerator *gen)
+{
+	board *b = gen->b;
+	sq king = gen->king;
+	pieceColor us = b->currentPlayer;
+	pieceColor them = us == pcWhite ? pcBlack : pcWhite;
+	int rank = us == pcWhite ? 1 : 8;
+	uint8_t shortBit = us == pcWhite ? CASTLE_WHITE_SHORT : CASTLE_BLACK_SHORT;
+	uint8_t longBit = us == pcWhite ? CASTLE_WHITE_LONG : CASTLE_BLACK_LONG;
+
+	if (!(b->castleState & (shortBit | longBit)) || king.file != 5 || king.rank != rank || gen->inCheck)
+		return;
+
+	// The king may not pass through check. Where it lands is checked like for any other king move
+	if ((b->castleState & shortBit) && moveBufferIsPiece(b, 8, rank, us, ptRook) &&
+			boardGetPiece(b, (sq) {6, rank}) == pEmpty && boardGetPiece(b, (sq) {7, rank}) == pEmpty &&
+			!moveBufferIsAttacked(b, (sq) {6, rank}, them))
+		moveBufferAdd(gen, moveSq(king, (sq) {7, rank}), (sq) {7, rank}, 1);
+
+	if ((b->castleState & longBit) && moveBufferIsPiece(b, 1, rank, us, ptRook) &&
+			boardGetPiece(b, (sq) {4, rank}) == pEmpty && boardGetPiece(b, (sq) {3, rank}) == pEmpty &&
+			boardGetPiece(b, (sq) {2, rank}) == pEmpty && !moveBufferIsAttacked(b, (sq) {4, rank}, them))
+		moveBufferAdd(gen, moveSq(king, (sq) {3, rank}), (sq) {3, rank}, 1);
+}
+
+// Generates straight into the array rather than through boardGenerateMoves, which allocates a list node for every move
+void moveBufferGenerate(moveBuffer *buf, board *b)
+{
+	buf->size = 0;
+
+	pieceColor us = b->currentPlayer;
+
+	moveGenerator gen;
+	gen.buf = buf;
+	gen.b = b;
+	gen.king = (sq) {0, 0};
+
+	for (int rank = 1; rank <= 8 && gen.king.file == 0; rank++)
+	{
+		for (int file = 1; file <= 8; file++)
+		{
+			if (moveBufferIsPiece(b, file, rank, us, ptKing))
+			{
+				gen.king = (sq) {file, rank};
+				break;
+			}
+		}
+	}
+
+	gen.inCheck = gen.king.file != 0 && moveBufferIsAttacked(b, gen.king, us == pcWhite ? pcBlack : pcWhite);
+
+	for (int rank = 1; rank <= 8; rank++)
+	{
+		for (int file = 1; file <= 8; file++)
+		{
+			sq from = {file, rank};
+			piece p = boardGetPiece(b, from);
+			if (p == pEmpty || pieceGetColor(p) != us)
+				continue;
+
+			switch (pieceGetType(p))
+			{
+				case ptPawn:
+					moveBufferGeneratePawn(&gen, from);
+					break;
+				case ptKnight:
+					moveBufferGeneratePiece(&gen, from, knightSteps, 8, 0, 0);
+					break;
+				case ptBishop:
+					moveBufferGeneratePiece(&gen, from, bishopDirections, 4, 1, 0);
+					break;
+				case ptRook:
+					moveBufferGeneratePiece(&gen, from, rookDirections, 4, 1, 0);
+					break;
+				case ptQueen:
+					moveBufferGeneratePiece(&gen, from, rookDirections, 4, 1, 0);
+					moveBufferGeneratePiece(&gen, from, bishopDirections, 4, 1, 0);
+					break;
+				case ptKing:
+					moveBufferGeneratePiece(&gen, from, kingSteps, 8, 0, 1);
+					moveBufferGenerateCastling(&gen);
+					break;
+				default:
+					break;
+			}
+		}
+	}
+}
@@ -0,0 +1,26 @@
+/*
+ * Move buffer declarations
+ */
+
+#ifndef MOVEBUFFER_H
+#define MOVEBUFFER_H
+
+#include "chesslib/board.h"
+
+// No legal position has more than 218 moves
+#define MOVE_BUFFER_CAPACITY 256
+
+// A contiguous copy of a move list, meant to live on the stack. Strategies copy the legal moves in here once and then
+// index it directly, instead of walking the linked list again for every access
+typedef struct
+{
+	move moves[MOVE_BUFFER_CAPACITY];
+	int size;
+} moveBuffer;
+
+void moveBufferFromList(moveBuffer *buf, moveList *list);
+
+// Fills the buffer with the legal moves of the given position
+void moveBufferGenerate(moveBuffer *buf, board *b);
+
+#endif
@@ -0,0 +1,71 @@
+/*
+ * Move notation implementation
+ */
+
+#include <ctype.h>
+
+#include "notation.h"
+
+void notationMoveToUci(move m, char *out)
+{
+	out[0] = 'a' + m.from.file - 1;
+	out[1] = '0' + m.from.rank;
+	out[2] = 'a' + m.to.file - 1;
+	out[3] = '0' + m.to.rank;
+
+	int i = 4;
+	switch (m.promotion)
+	{
+		case ptKnight:
+			out[i++] = 'n';
+			break;
+		case ptBishop:
+			out[i++] = 'b';
+			break;
+		case ptRook:
+			out[i++] = 'r';
+			break;
+		case ptQueen:
+			out[i++] = 'q';
+			break;
+		default:
+			break;
+	}
+	out[i] = '\0';
+}
+
+static int notationParseSquare(const char *str, sq *s)
+{
+	if (str[0] < 'a' || str[0] > 'h' || str[1] < '1' || str[1] > '8')
+		return 0;
+
+	s->file = str[0] - 'a' + 1;
+	s->rank = str[1] - '0';
+	return 1;
+}
+
+int notationMoveFromUci(const char *str, move *m)
+{
+	if (!notationParseSquare(str, &m->from) || !notationParseSquare(str + 2, &m->to))
+		return 0;
+
+	switch (tolower((unsigned char) str[4]))
+	{
+		case 'n':
+			m->promotion = ptKnight;
+			break;
+		case 'b':
+			m->promotion = ptBishop;
+			break;
+		case 'r':
+			m->promotion = ptRook;
+			break;
+		case 'q':
+			m->promotion = ptQueen;
+			break;
+		default:
+			m->promotion = ptEmpty;
+			break;
+	}
+	return 1;
+}
@@ -0,0 +1,19 @@
+/*
+ * Move notation declarations
+ */
+
+#ifndef NOTATION_H
+#define NOTATION_H
+
+#include "chesslib/move.h"
+
+// Long enough for any UCI move, e.g. "e7e8q", plus the terminator
+#define NOTATION_UCI_LENGTH 6
+
+// Writes the move in UCI notation (e.g. "e2e4", "e7e8q") into out
+void notationMoveToUci(move m, char *out);
+
+// Parses a move in UCI notation. Returns true on success. This only checks the syntax, not whether the move is legal
+int notationMoveFromUci(const char *str, move *m);
+
+#endif
@@ -0,0 +1,427 @@
+/*
+ * Perft benchmark implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include <SFML/System.h>
+
+#include "chesslib/chess.h"
+
+#include "perft.h"
+#include "notation.h"
+#include "movebuffer.h"
+#include "threadpool.h"
+
+#define PERFT_SUITE_MAX_DEPTH 6
+
+// One subtree to count: a position splitDepth plies below the root
+typedef struct
+{
+	board position;
+	int rootMove; // Index of the root move this subtree is under, for --divide
+	unsigned long long count;
+} perftTask;
+
+// A Chase-Lev work-stealing deque of task indices. The owning worker pushes and pops at the bottom, and idle workers
+// steal from the top. All tasks are pushed before the workers start, so the array never has to grow
+typedef struct
+{
+	atomic_long top;
+	atomic_long bottom;
+	int *tasks;
+} perftDeque;
+
+typedef struct
+{
+	perftTask *tasks;
+	int numTasks;
+	int taskCapacity;
+
+	perftDeque *deques;
+	int numWorkers;
+
+	int remainingDepth; // Depth below each task's position
+	board *stacks; // PERFT_MAX_DEPTH + 1 scratch boards per worker
+} perftJob;
+
+typedef struct
+{
+	const char *name;
+	const char *fen;
+	int depth; // The depth the suite runs this position at
+	unsigned long long counts[PERFT_SUITE_MAX_DEPTH]; // Known counts for depths 1 to 6
+} perftPosition;
+
+// From https://www.chessprogramming.org/Perft_Results
+static const perftPosition perftSuite[] =
+{
+	{
+		"Initial position",
+		"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+		5,
+		{20, 400, 8902, 197281, 4865609, 119060324},
+	},
+	{
+		"Kiwipete",
+		"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+		4,
+		{48, 2039, 97862, 4085603, 193690690, 8031647685ULL},
+	},
+	{
+		"Position 3",
+		"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+		5,
+		{14, 191, 2812, 43238, 674624, 11030083},
+	},
+	{
+		"Position 4",
+		"r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+		4,
+		{6, 264, 9467, 422333, 15833292, 706045033},
+	},
+	{
+		"Position 5",
+		"rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+		4,
+		{44, 1486, 62379, 2103487, 89941194, 0},
+	},
+	{
+		"Position 6",
+		"r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+		4,
+		{46, 2079, 89890, 3894594, 164075551, 6923051137ULL},
+	},
+};
+
+#define PERFT_SUITE_SIZE ((int) (sizeof(perftSuite) / sizeof(perftSuite[0])))
+
+unsigned long long perftCount(board *b, int depth, board *stack)
+{
+	if (depth == 0)
+		return 1;
+
+	moveList *list = boardGenerateMoves(b);
+
+	// Bulk count: the leaves are just the legal moves of the last ply, no need to play them
+	if (depth == 1)
+	{
+		unsigned long long count = list->size;
+		moveListFree(list);
+		return count;
+	}
+
+	unsigned long long count = 0;
+	board *child = stack + 1;
+
+	for (moveListNode *n = list->head; n; n = n->next)
+	{
+		memcpy(child, b, sizeof(board));
+		boardPlayMoveInPlace(child, n->move);
+		count += perftCount(child, depth - 1, child);
+	}
+
+	moveListFree(list);
+	return count;
+}
+
+// Loads the position from a FEN into the given board. Returns true on success
+static int perftLoadFen(const char *fen, board *b)
+{
+	chess *c = chessCreateFen(fen);
+	if (!c)
+		return 0;
+
+	memcpy(b, chessGetBoard(c), sizeof(board));
+	chessFree(c);
+	return 1;
+}
+
+static void perftPrintSpeed(unsigned long long nodes, float seconds)
+{
+	if (seconds <= 0.0f)
+		seconds = 1e-6f;
+
+	printf("%llu nodes in %.3f s (%.0f nps)\n", nodes, seconds, nodes / seconds);
+}
+
+static void perftDequePush(perftDeque *d, int task)
+{
+	long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+	d->tasks[b] = task;
+	atomic_store_explicit(&d->bottom, b + 1, memory_order_release);
+}
+
+// Called by the owner. Returns true and sets task if the deque wasn't empty
+static int perftDequePop(perftDeque *d, int *task)
+{
+	long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+	atomic_store_explicit(&d->bottom, b, memory_order_seq_cst);
+	long t = atomic_load_explicit(&d->top, memory_order_seq_cst);
+
+	if (t > b)
+	{
+		// Empty
+		atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+		return 0;
+	}
+
+	*task = d->tasks[b];
+	if (t == b)
+	{
+		// Last task, race the thieves for it
+		int won = atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst,
+				memory_order_relaxed);
+		atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+		return won;
+	}
+
+	return 1;
+}
+
+// Called by other workers. Returns 1 and sets task on success, 0 if the deque is empty, and -1 if another worker got
+// there first and it's worth trying again
+static int perftDequeSteal(perftDeque *d, int *task)
+{
+	long t = atomic_load_explicit(&d->top, memory_order_seq_cst);
+	long b = atomic_load_explicit(&d->bottom, memory_order_seq_cst);
+
+	if (t >= b)
+		return 0;
+
+	*task = d->tasks[t];
+	if (!atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed))
+		return -1;
+
+	return 1;
+}
+
+static void perftAddTask(perftJob *job, board *b, int rootMove)
+{
+	if (job->numTasks == job->taskCapacity)
+	{
+		job->taskCapacity = job->taskCapacity ? job->taskCapacity * 2 : 256;
+		job->tasks = (perftTask *) realloc(job->tasks, job->taskCapacity * sizeof(perftTask));
+	}
+
+	perftTask *task = &job->tasks[job->numTasks++];
+	memcpy(&task->position, b, sizeof(board));
+	task->rootMove = rootMove;
+	task->count = 0;
+}
+
+// Adds every position depth plies below b as a task
+static void perftSplit(perftJob *job, board *b, int depth, int rootMove, board *stack)
+{
+	if (depth == 0)
+	{
+		perftAddTask(job, b, rootMove);
+		return;
+	}
+
+	moveList *list = boardGenerateMoves(b);
+	board *child = stack + 1;
+
+	for (moveListNode *n = list->head; n; n = n->next)
+	{
+		memcpy(child, b, sizeof(board));
+		boardPlayMoveInPlace(child, n->move);
+		perftSplit(job, child, depth - 1, rootMove, child);
+	}
+
+	moveListFree(list);
+}
+
+static void perftWorkerRun(void *userData, int workerIndex, int dequeIndex)
+{
+	(void) workerIndex;
+
+	perftJob *job = (perftJob *) userData;
+	perftDeque *own = &job->deques[dequeIndex];
+	board *stack = &job->stacks[dequeIndex * (PERFT_MAX_DEPTH + 1)];
+
+	while (1)
+	{
+		int t;
+		if (!perftDequePop(own, &t))
+		{
+			// Out of our own work, so look for some in the other deques. Nothing is ever pushed once the workers
+			// have started, so if every deque is seen empty, all of the work has been handed out
+			int result = 0;
+			do
+			{
+				int retry = 0;
+				for (int i = 1; i < job->numWorkers; i++)
+				{
+					result = perftDequeSteal(&job->deques[(dequeIndex + i) % job->numWorkers], &t);
+					if (result == 1)
+						break;
+					if (result == -1)
+						retry = 1;
+				}
+				if (result != 1 && !retry)
+					return;
+			}
+			while (result != 1);
+		}
+
+		perftTask *task = &job->tasks[t];
+		memcpy(&stack[0], &task->position, sizeof(board));
+		task->count = perftCount(&stack[0], job->remainingDepth, &stack[0]);
+	}
+}
+
+// Counts the tree below root on numThreads workers. If rootCounts is given, it receives the count below each legal
+// root move, in the order of rootMoves
+static unsigned long long perftParallel(board *root, int depth, int numThreads, int splitDepth, moveBuffer *rootMoves,
+		unsigned long long *rootCounts)
+{
+	if (numThreads <= 0)
+		numThreads = threadPoolGetCpuCount();
+
+	// Splitting at the leaves would turn every leaf into a task, so always leave at least one ply to count
+	if (splitDepth >= depth)
+		splitDepth = depth - 1;
+	if (splitDepth < 1)
+		splitDepth = 1;
+
+	perftJob job;
+	memset(&job, 0, sizeof(job));
+	job.remainingDepth = depth - splitDepth;
+	job.numWorkers = numThreads;
+
+	// Split the tree into tasks, one root move at a time so we know which root move each task belongs to
+	board stack[PERFT_MAX_DEPTH + 1];
+	for (int i = 0; i < rootMoves->size; i++)
+	{
+		memcpy(&stack[1], root, sizeof(board));
+		boardPlayMoveInPlace(&stack[1], rootMoves->moves[i]);
+		perftSplit(&job, &stack[1], splitDepth - 1, i, &stack[1]);
+	}
+
+	// Deal the tasks out round robin. Neighbouring tasks tend to be similar in size, so this starts out fairly even,
+	// and stealing evens out the rest
+	job.deques = (perftDeque *) malloc(numThreads * sizeof(perftDeque));
+	for (int i = 0; i < numThreads; i++)
+	{
+		atomic_init(&job.deques[i].top, 0);
+		atomic_init(&job.deques[i].bottom, 0);
+		job.deques[i].tasks = (int *) malloc((job.numTasks / numThreads + 1) * sizeof(int));
+	}
+	for (int i = 0; i < job.numTasks; i++)
+		perftDequePush(&job.deques[i % numThreads], i);
+
+	job.stacks = (board *) malloc(numThreads * (PERFT_MAX_DEPTH + 1) * sizeof(board));
+
+	threadPool *pool = threadPoolCreate(numThreads);
+	threadPoolRun(pool, perftWorkerRun, &job, numThreads);
+	threadPoolFree(pool);
+
+	unsigned long long total = 0;
+	if (rootCounts)
+		memset(rootCounts, 0, rootMoves->size * sizeof(unsigned long long));
+
+	for (int i = 0; i < job.numTasks; i++)
+	{
+		total += job.tasks[i].count;
+		if (rootCounts)
+			rootCounts[job.tasks[i].rootMove] += job.tasks[i].count;
+	}
+
+	for (int i = 0; i < numThreads; i++)
+		free(job.deques[i].tasks);
+	free(job.deques);
+	free(job.stacks);
+	free(job.tasks);
+
+	return total;
+}
+
+int perftRun(const char *fen, int depth, int divide, int numThreads, int splitDepth)
+{
+	if (depth < 1 || depth > PERFT_MAX_DEPTH)
+	{
+		fprintf(stderr, "ERROR: Perft depth must be between 1 and %d\n", PERFT_MAX_DEPTH);
+		return 1;
+	}
+
+	board root;
+	if (!perftLoadFen(fen, &root))
+	{
+		fprintf(stderr, "ERROR: Invalid FEN \"%s\"\n", fen);
+		return 1;
+	}
+
+	printf("%s \"%s\" depth %d\n", divide ? "Divide" : "Perft", fen, depth);
+	fflush(stdout);
+
+	moveBuffer rootMoves;
+	moveBufferGenerate(&rootMoves, &root);
+	unsigned long long rootCounts[MOVE_BUFFER_CAPACITY];
+
+	sfClock *clock = sfClock_create();
+	unsigned long long total = perftParallel(&root, depth, numThreads, splitDepth, &rootMoves, rootCounts);
+	float seconds = sfTime_asSeconds(sfClock_getElapsedTime(clock));
+	sfClock_destroy(clock);
+
+	if (divide)
+	{
+		for (int i = 0; i < rootMoves.size; i++)
+		{
+			char uci[NOTATION_UCI_LENGTH];
+			notationMoveToUci(rootMoves.moves[i], uci);
+			printf("%s: %llu\n", uci, rootCounts[i]);
+		}
+
+		printf("\nMoves: %d\n", rootMoves.size);
+	}
+
+	perftPrintSpeed(total, seconds);
+
+	return 0;
+}
+
+int perftRunSuite(int numThreads, int splitDepth)
+{
+	int failures = 0;
+	unsigned long long totalNodes = 0;
+	float totalSeconds = 0.0f;
+
+	for (int i = 0; i < PERFT_SUITE_SIZE; i++)
+	{
+		const perftPosition *pos = &perftSuite[i];
+		unsigned long long expected = pos->counts[pos->depth - 1];
+
+		board root;
+		perftLoadFen(pos->fen, &root);
+
+		moveBuffer rootMoves;
+		moveBufferGenerate(&rootMoves, &root);
+
+		sfClock *clock = sfClock_create();
+		unsigned long long count = perftParallel(&root, pos->depth, numThreads, splitDepth, &rootMoves, NULL);
+		float seconds = sfTime_asSeconds(sfClock_getElapsedTime(clock));
+		sfClock_destroy(clock);
+
+		int pass = count == expected;
+		if (!pass)
+			failures++;
+
+		totalNodes += count;
+		totalSeconds += seconds;
+
+		printf("%s  %-16s depth %d: %12llu", pass ? "PASS" : "FAIL", pos->name, pos->depth, count);
+		if (!pass)
+			printf(" (expected %llu)", expected);
+		printf("   %.3f s\n", seconds);
+		fflush(stdout);
+	}
+
+	printf("\n%d of %d positions passed\n", PERFT_SUITE_SIZE - failures, PERFT_SUITE_SIZE);
+	perftPrintSpeed(totalNodes, totalSeconds);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,28 @@
+/*
+ * Perft benchmark declarations
+ */
+
+#ifndef PERFT_H
+#define PERFT_H
+
+#include "chesslib/board.h"
+
+#define PERFT_MAX_DEPTH 16
+
+// Counts the leaf nodes of the legal move tree of the given depth below b. stack must have room for depth + 1 boards,
+// and b may be the first of them
+unsigned long long perftCount(board *b, int depth, board *stack);
+
+// Default number of plies below the root at which the tree is split into tasks for the workers
+#define PERFT_DEFAULT_SPLIT_DEPTH 2
+
+// Runs perft on the given position and prints the node count, time and nodes/sec. With divide, also prints the
+// count below each root move. The tree is split into the subtrees splitDepth plies below the root, which are counted
+// on numThreads work-stealing workers (0 means one per core). Returns the process exit code
+int perftRun(const char *fen, int depth, int divide, int numThreads, int splitDepth);
+
+// Runs perft on a built-in suite of well known positions and checks the counts against their known values. Returns
+// the process exit code, which is nonzero if any count was wrong
+int perftRunSuite(int numThreads, int splitDepth);
+
+#endif
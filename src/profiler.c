@@ -0,0 +1,188 @@
+/*
+ * Profiler implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#include <SFML/System.h>
+
+#include "profiler.h"
+
+typedef struct
+{
+	profileZone zone;
+	int threadId;
+	int64_t start;
+	int64_t duration;
+} profileEvent;
+
+typedef struct
+{
+	int64_t durations[PROFILE_HISTORY_SIZE];
+	int next;
+	int samples;
+} profileHistory;
+
+static const char *zoneNames[PROFILE_ZONE_COUNT] =
+{
+	"frame",
+	"events",
+	"board build",
+	"board queries",
+	"window title",
+	"ai move",
+	"display",
+};
+
+static sfClock *profileClock = NULL;
+static sfMutex *profileMutex = NULL;
+static atomic_int enabled;
+
+static profileHistory histories[PROFILE_ZONE_COUNT];
+
+// Trace events are kept in memory and only written out at exit, so recording one is just an append
+static FILE *traceFile = NULL;
+static profileEvent *events = NULL;
+static size_t numEvents = 0;
+static size_t eventCapacity = 0;
+
+// Chrome traces group events by thread. Ids are handed out the first time a thread finishes a timing
+static atomic_int nextThreadId;
+static _Thread_local int threadId = 0;
+
+int profilerInit(const char *tracePath)
+{
+	profileClock = sfClock_create();
+	profileMutex = sfMutex_create();
+	atomic_init(&enabled, 0);
+	atomic_init(&nextThreadId, 1);
+
+	if (tracePath)
+	{
+		traceFile = fopen(tracePath, "w");
+		if (!traceFile)
+		{
+			fprintf(stderr, "ERROR: Unable to open trace file %s\n", tracePath);
+			return 0;
+		}
+
+		atomic_store(&enabled, 1);
+	}
+
+	return 1;
+}
+
+void profilerShutdown()
+{
+	if (traceFile)
+	{
+		fprintf(traceFile, "{\"traceEvents\":[\n");
+		for (size_t i = 0; i < numEvents; i++)
+		{
+			profileEvent *e = &events[i];
+			fprintf(traceFile, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%lld,\"dur\":%lld}%s\n",
+					zoneNames[e->zone], e->threadId, (long long) e->start, (long long) e->duration,
+					i + 1 < numEvents ? "," : "");
+		}
+		fprintf(traceFile, "],\"displayTimeUnit\":\"ms\"}\n");
+
+		fclose(traceFile);
+		traceFile = NULL;
+	}
+
+	free(events);
+	events = NULL;
+	numEvents = 0;
+	eventCapacity = 0;
+
+	if (profileMutex)
+		sfMutex_destroy(profileMutex);
+	if (profileClock)
+		sfClock_destroy(profileClock);
+	profileMutex = NULL;
+	profileClock = NULL;
+}
+
+void profilerSetEnabled(int enable)
+{
+	// A trace has to see everything, so it can't be switched off
+	atomic_store_explicit(&enabled, enable || traceFile, memory_order_relaxed);
+}
+
+int profilerIsEnabled()
+{
+	return atomic_load_explicit(&enabled, memory_order_relaxed);
+}
+
+int64_t profileBegin()
+{
+	if (!atomic_load_explicit(&enabled, memory_order_relaxed))
+		return -1;
+
+	return sfTime_asMicroseconds(sfClock_getElapsedTime(profileClock));
+}
+
+void profileEnd(profileZone zone, int64_t start)
+{
+	// The profiler was disabled when this timing started
+	if (start < 0)
+		return;
+
+	int64_t duration = sfTime_asMicroseconds(sfClock_getElapsedTime(profileClock)) - start;
+
+	if (!threadId)
+		threadId = atomic_fetch_add(&nextThreadId, 1);
+
+	sfMutex_lock(profileMutex);
+
+	profileHistory *h = &histories[zone];
+	h->durations[h->next] = duration;
+	h->next = (h->next + 1) % PROFILE_HISTORY_SIZE;
+	if (h->samples < PROFILE_HISTORY_SIZE)
+		h->samples++;
+
+	if (traceFile)
+	{
+		if (numEvents == eventCapacity)
+		{
+			eventCapacity = eventCapacity ? eventCapacity * 2 : 4096;
+			events = (profileEvent *) realloc(events, eventCapacity * sizeof(profileEvent));
+		}
+
+		events[numEvents++] = (profileEvent) {zone, threadId, start, duration};
+	}
+
+	sfMutex_unlock(profileMutex);
+}
+
+const char *profileZoneName(profileZone zone)
+{
+	return zoneNames[zone];
+}
+
+void profilerGetStats(profileZone zone, profileStats *stats)
+{
+	sfMutex_lock(profileMutex);
+
+	profileHistory *h = &histories[zone];
+
+	int64_t total = 0;
+	int64_t max = 0;
+	for (int i = 0; i < h->samples; i++)
+	{
+		total += h->durations[i];
+		if (h->durations[i] > max)
+			max = h->durations[i];
+	}
+
+	int last = (h->next + PROFILE_HISTORY_SIZE - 1) % PROFILE_HISTORY_SIZE;
+
+	stats->samples = h->samples;
+	stats->lastMs = h->samples ? (double) h->durations[last] / 1000.0 : 0.0;
+	stats->avgMs = h->samples ? (double) total / (double) h->samples / 1000.0 : 0.0;
+	stats->maxMs = (double) max / 1000.0;
+
+	sfMutex_unlock(profileMutex);
+}
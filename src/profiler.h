@@ -0,0 +1,53 @@
+/*
+ * Profiler declarations
+ */
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+
+typedef enum
+{
+	pzFrame,
+	pzEvents,
+	pzBoardBuild,
+	pzBoardQueries,
+	pzWindowTitle,
+	pzAiMove,
+	pzDisplay,
+	PROFILE_ZONE_COUNT
+} profileZone;
+
+// How many of the most recent timings of each zone the statistics are taken over
+#define PROFILE_HISTORY_SIZE 64
+
+typedef struct
+{
+	double lastMs;
+	double avgMs;
+	double maxMs;
+	int samples;
+} profileStats;
+
+// Starts the profiler. If tracePath is not NULL, every timing is also recorded and written there as a Chrome trace
+// (chrome://tracing or ui.perfetto.dev) by profilerShutdown. Returns false if the trace file can't be opened
+int profilerInit(const char *tracePath);
+void profilerShutdown();
+
+// Timings are only collected while the profiler is enabled. Recording a trace keeps it enabled
+void profilerSetEnabled(int enabled);
+int profilerIsEnabled();
+
+// Time a piece of code by wrapping it in profileBegin and profileEnd:
+//     int64_t t = profileBegin();
+//     ...
+//     profileEnd(pzDisplay, t);
+// Both are safe to call from any thread, and cost one branch while the profiler is disabled
+int64_t profileBegin();
+void profileEnd(profileZone zone, int64_t start);
+
+const char *profileZoneName(profileZone zone);
+void profilerGetStats(profileZone zone, profileStats *stats);
+
+#endif
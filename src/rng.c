@@ -0,0 +1,32 @@
+/*
+ * Random number generator implementation
+ */
+
+#include "rng.h"
+
+void rngSeed(rng *r, uint64_t seed)
+{
+	// Run the seed through splitmix64 so that similar seeds (e.g. consecutive game indices) give unrelated streams
+	uint64_t z = seed + 0x9E3779B97F4A7C15ULL;
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	z = z ^ (z >> 31);
+
+	// xorshift must never have a state of zero
+	r->state = z ? z : 0x9E3779B97F4A7C15ULL;
+}
+
+uint64_t rngNext(rng *r)
+{
+	uint64_t x = r->state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	r->state = x;
+	return x * 0x2545F4914F6CDD1DULL;
+}
+
+int rngInt(rng *r, int n)
+{
+	return (int) ((rngNext(r) >> 32) % (uint64_t) n);
+}
@@ -0,0 +1,22 @@
+/*
+ * Random number generator declarations
+ */
+
+#ifndef RNG_H
+#define RNG_H
+
+#include <stdint.h>
+
+// Small xorshift64* generator. Each thread (or game) owns one of these so that nothing touches the global rand()
+typedef struct
+{
+	uint64_t state;
+} rng;
+
+void rngSeed(rng *r, uint64_t seed);
+uint64_t rngNext(rng *r);
+
+// Returns a random integer in the range [0, n)
+int rngInt(rng *r, int n);
+
+#endif
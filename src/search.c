@@ -0,0 +1,636 @@
+/*
+ * Alpha-beta search implementation
+ */
+
+#include <string.h>
+#include <stdatomic.h>
+
+#include <SFML/System.h>
+
+#include "search.h"
+#include "eval.h"
+#include "tt.h"
+#include "zobrist.h"
+#include "movebuffer.h"
+
+// Move ordering scores
+#define ORDER_TT_MOVE 1000000
+#define ORDER_CAPTURE 100000
+#define ORDER_KILLER 90000
+
+typedef struct
+{
+	aiContext *ctx;
+	ttTable *tt;
+	searchLimits limits;
+
+	// 0 for the main search, whose result is the one that counts. Helper searches only fill in the shared
+	// transposition table, and are stopped through helperStop when the main search finishes
+	int threadIndex;
+	atomic_int *helperStop;
+
+	// Each thread has its own, so the root move order differs between threads
+	rng r;
+
+	unsigned long long nodes;
+	int stopped;
+
+	// A copy of nodes which other threads may read while the search runs. Only updated every so often
+	atomic_ullong sharedNodes;
+
+	// Only created when there is a time limit
+	sfClock *clock;
+
+	// Copy-make stack: the position at each ply is copied from the previous ply and then played into in place, so no
+	// boards are allocated while searching
+	board boards[SEARCH_MAX_PLY + 1];
+	uint64_t keys[SEARCH_MAX_PLY + 1];
+
+	// Keys of the game's positions before the root, oldest first, so the search also sees repetitions of those
+	uint64_t history[SEARCH_MAX_HISTORY];
+	int historyLength;
+
+	// The moves of each ply and their ordering scores
+	moveBuffer moves[SEARCH_MAX_PLY + 1];
+	int scores[SEARCH_MAX_PLY + 1][MOVE_BUFFER_CAPACITY];
+
+	move killers[SEARCH_MAX_PLY][2];
+
+	move rootBest;
+
+	// Moves left out at the root, which are the ones already found by earlier lines of a multi-PV search
+	move excluded[SEARCH_MAX_LINES];
+	int numExcluded;
+} searchState;
+
+static int movesEqual(move m1, move m2)
+{
+	return sqEq(m1.from, m2.from) && sqEq(m1.to, m2.to) && m1.promotion == m2.promotion;
+}
+
+static int searchElapsedMs(searchState *s)
+{
+	return sfTime_asMilliseconds(sfClock_getElapsedTime(s->clock));
+}
+
+static int searchShouldStop(searchState *s)
+{
+	if (s->stopped)
+		return 1;
+
+	if ((s->limits.nodes && s->nodes >= s->limits.nodes) || aiShouldStop(s->ctx))
+		s->stopped = 1;
+
+	if (s->helperStop && atomic_load_explicit(s->helperStop, memory_order_relaxed))
+		s->stopped = 1;
+
+	// Reading the clock costs far more than a node, so only do it every so often
+	if ((s->nodes & (SEARCH_TIME_CHECK_NODES - 1)) == 0)
+	{
+		atomic_store_explicit(&s->sharedNodes, s->nodes, memory_order_relaxed);
+
+		if (s->clock && searchElapsedMs(s) >= s->limits.timeMs)
+			s->stopped = 1;
+	}
+
+	return s->stopped;
+}
+
+static int isCapture(board *b, move m)
+{
+	if (boardGetPiece(b, m.to))
+		return 1;
+
+	// En passant
+	return pieceGetType(boardGetPiece(b, m.from)) == ptPawn && m.from.file != m.to.file;
+}
+
+// Mate scores are stored relative to the position rather than the root, so they stay correct when the same position
+// is reached at a different ply
+static int scoreToTt(int score, int ply)
+{
+	if (score >= SCORE_MATE_BOUND)
+		return score + ply;
+	if (score <= -SCORE_MATE_BOUND)
+		return score - ply;
+	return score;
+}
+
+static int scoreFromTt(int score, int ply)
+{
+	if (score >= SCORE_MATE_BOUND)
+		return score - ply;
+	if (score <= -SCORE_MATE_BOUND)
+		return score + ply;
+	return score;
+}
+
+static void orderMoves(searchState *s, board *b, int ply, move *moves, int *scores, int count, move ttMove)
+{
+	for (int i = 0; i < count; i++)
+	{
+		move m = moves[i];
+
+		if (movesEqual(m, ttMove))
+		{
+			scores[i] = ORDER_TT_MOVE;
+		}
+		else if (isCapture(b, m))
+		{
+			// MVV-LVA: most valuable victim first, then least valuable attacker
+			piece victim = boardGetPiece(b, m.to);
+			int victimValue = victim ? evalPieceValue(pieceGetType(victim)) : evalPieceValue(ptPawn);
+			int attackerValue = evalPieceValue(pieceGetType(boardGetPiece(b, m.from)));
+
+			scores[i] = ORDER_CAPTURE + 10 * victimValue - attackerValue / 10;
+		}
+		else if (m.promotion)
+		{
+			scores[i] = ORDER_CAPTURE + evalPieceValue(m.promotion);
+		}
+		else if (movesEqual(m, s->killers[ply][0]) || movesEqual(m, s->killers[ply][1]))
+		{
+			scores[i] = ORDER_KILLER;
+		}
+		else
+		{
+			// At the root, break ties between quiet moves randomly, so that games against the same opponent differ
+			scores[i] = ply == 0 ? rngInt(&s->r, 64) : 0;
+		}
+	}
+}
+
+// Moves the best remaining move to index i. This is a selection sort spread out over the move loop, which is cheaper
+// than a full sort when a cutoff happens early
+static void pickMove(move *moves, int *scores, int count, int i)
+{
+	int best = i;
+	for (int j = i + 1; j < count; j++)
+	{
+		if (scores[j] > scores[best])
+			best = j;
+	}
+
+	move tmpMove = moves[i];
+	moves[i] = moves[best];
+	moves[best] = tmpMove;
+
+	int tmpScore = scores[i];
+	scores[i] = scores[best];
+	scores[best] = tmpScore;
+}
+
+static int isRepetition(searchState *s, int ply)
+{
+	board *b = &s->boards[ply];
+
+	// Only positions since the last capture or pawn move can repeat, and only with the same player to move. Negative
+	// plies are the game's positions before the root
+	for (int i = ply - 2; i >= -s->historyLength && i >= ply - (int) b->halfMoveClock; i -= 2)
+	{
+		uint64_t key = i >= 0 ? s->keys[i] : s->history[s->historyLength + i];
+		if (key == s->keys[ply])
+			return 1;
+	}
+
+	return 0;
+}
+
+static int quiesce(searchState *s, int ply, int alpha, int beta)
+{
+	s->nodes++;
+	if (searchShouldStop(s))
+		return 0;
+
+	board *b = &s->boards[ply];
+
+	int inCheck = boardIsInCheck(b);
+	int standPat = evalBoard(b);
+
+	if (ply >= SEARCH_MAX_PLY)
+		return standPat;
+
+	// When not in check, the player can choose not to capture anything
+	if (!inCheck)
+	{
+		if (standPat >= beta)
+			return standPat;
+		if (standPat > alpha)
+			alpha = standPat;
+	}
+
+	moveBuffer *buf = &s->moves[ply];
+	moveBufferGenerate(buf, b);
+
+	if (buf->size == 0)
+		return inCheck ? -SCORE_MATE + ply : 0;
+
+	// Only look at captures and promotions, unless we have to get out of check
+	move *moves = buf->moves;
+	int *scores = s->scores[ply];
+	int tacticalCount = 0;
+	for (int i = 0; i < buf->size; i++)
+	{
+		if (inCheck || isCapture(b, moves[i]) || moves[i].promotion == ptQueen)
+			moves[tacticalCount++] = moves[i];
+	}
+
+	move noMove = {SQ_INVALID, SQ_INVALID, ptEmpty};
+	orderMoves(s, b, ply, moves, scores, tacticalCount, noMove);
+
+	int bestScore = inCheck ? -SCORE_INFINITE : standPat;
+
+	for (int i = 0; i < tacticalCount; i++)
+	{
+		pickMove(moves, scores, tacticalCount, i);
+
+		board *child = &s->boards[ply + 1];
+		memcpy(child, b, sizeof(board));
+		boardPlayMoveInPlace(child, moves[i]);
+
+		int score = -quiesce(s, ply + 1, -beta, -alpha);
+		if (s->stopped)
+			return 0;
+
+		if (score > bestScore)
+		{
+			bestScore = score;
+			if (score > alpha)
+			{
+				alpha = score;
+				if (score >= beta)
+					break;
+			}
+		}
+	}
+
+	return bestScore;
+}
+
+static int excludeRootMoves(searchState *s, move *moves, int count)
+{
+	int kept = 0;
+	for (int i = 0; i < count; i++)
+	{
+		int isExcluded = 0;
+		for (int j = 0; j < s->numExcluded; j++)
+			isExcluded |= movesEqual(moves[i], s->excluded[j]);
+
+		if (!isExcluded)
+			moves[kept++] = moves[i];
+	}
+	return kept;
+}
+
+// Follows the moves stored in the transposition table from the position after first, for as long as they are legal.
+// Uses the boards of the search stack, so only call this between searches
+static void extractLine(searchState *s, move first, int score, searchLine *line)
+{
+	line->moves[0] = first;
+	line->length = 1;
+	line->score = score;
+
+	if (!s->tt)
+		return;
+
+	memcpy(&s->boards[1], &s->boards[0], sizeof(board));
+	boardPlayMoveInPlace(&s->boards[1], first);
+	s->keys[1] = zobristUpdate(s->keys[0], &s->boards[0], &s->boards[1], first);
+
+	for (int ply = 1; line->length < SEARCH_MAX_PV_LENGTH && ply < SEARCH_MAX_PLY; ply++)
+	{
+		// Stop at the first repeat, or the line could go round in circles
+		if (isRepetition(s, ply))
+			return;
+
+		ttData entry;
+		if (!ttProbe(s->tt, s->keys[ply], &entry))
+			return;
+
+		moveBuffer *buf = &s->moves[ply];
+		moveBufferGenerate(buf, &s->boards[ply]);
+
+		int isLegal = 0;
+		for (int i = 0; i < buf->size; i++)
+			isLegal |= movesEqual(buf->moves[i], entry.m);
+		if (!isLegal)
+			return;
+
+		line->moves[line->length++] = entry.m;
+
+		memcpy(&s->boards[ply + 1], &s->boards[ply], sizeof(board));
+		boardPlayMoveInPlace(&s->boards[ply + 1], entry.m);
+		s->keys[ply + 1] = zobristUpdate(s->keys[ply], &s->boards[ply], &s->boards[ply + 1], entry.m);
+	}
+}
+
+static int negamax(searchState *s, int ply, int depth, int alpha, int beta)
+{
+	if (depth <= 0 || ply >= SEARCH_MAX_PLY)
+		return quiesce(s, ply, alpha, beta);
+
+	s->nodes++;
+	if (searchShouldStop(s))
+		return 0;
+
+	board *b = &s->boards[ply];
+	uint64_t key = s->keys[ply];
+
+	if (ply > 0 && (b->halfMoveClock >= 100 || isRepetition(s, ply)))
+		return 0;
+
+	// Look the position up in the transposition table
+	move ttMove = {SQ_INVALID, SQ_INVALID, ptEmpty};
+	ttData entry;
+	if (s->tt && ttProbe(s->tt, key, &entry))
+	{
+		ttMove = entry.m;
+
+		if (ply > 0 && entry.depth >= depth)
+		{
+			int ttScore = scoreFromTt(entry.score, ply);
+			if (entry.bound == ttExact ||
+					(entry.bound == ttLower && ttScore >= beta) ||
+					(entry.bound == ttUpper && ttScore <= alpha))
+				return ttScore;
+		}
+	}
+
+	moveBuffer *buf = &s->moves[ply];
+	moveBufferGenerate(buf, b);
+
+	if (buf->size == 0)
+		return boardIsInCheck(b) ? -SCORE_MATE + ply : 0;
+
+	move *moves = buf->moves;
+	int count = buf->size;
+	int *scores = s->scores[ply];
+
+	if (ply == 0 && s->numExcluded)
+		count = excludeRootMoves(s, moves, count);
+
+	orderMoves(s, b, ply, moves, scores, count, ttMove);
+
+	int originalAlpha = alpha;
+	int bestScore = -SCORE_INFINITE;
+	move bestMove = moves[0];
+
+	for (int i = 0; i < count; i++)
+	{
+		pickMove(moves, scores, count, i);
+		move m = moves[i];
+
+		board *child = &s->boards[ply + 1];
+		memcpy(child, b, sizeof(board));
+		boardPlayMoveInPlace(child, m);
+		s->keys[ply + 1] = zobristUpdate(s->keys[ply], b, child, m);
+
+		int score = -negamax(s, ply + 1, depth - 1, -beta, -alpha);
+		if (s->stopped)
+			return 0;
+
+		if (score > bestScore)
+		{
+			bestScore = score;
+			bestMove = m;
+
+			if (ply == 0)
+				s->rootBest = m;
+
+			if (score > alpha)
+			{
+				alpha = score;
+
+				if (score >= beta)
+				{
+					// Remember quiet moves which caused a cutoff, they are likely to be good in sibling positions too
+					if (!isCapture(b, m) && !movesEqual(m, s->killers[ply][0]))
+					{
+						s->killers[ply][1] = s->killers[ply][0];
+						s->killers[ply][0] = m;
+					}
+					break;
+				}
+			}
+		}
+	}
+
+	// With moves left out, the best move found here isn't really the best move of the position
+	if (s->tt && !(ply == 0 && s->numExcluded))
+	{
+		ttBound bound = bestScore >= beta ? ttLower : (bestScore > originalAlpha ? ttExact : ttUpper);
+		ttStore(s->tt, key, bestMove, scoreToTt(bestScore, ply), depth, bound);
+	}
+
+	return bestScore;
+}
+
+// Shared by every thread of one search
+typedef struct
+{
+	searchState **states;
+	int numThreads;
+	int numLines;
+	int maxDepth;
+	atomic_int helperStop;
+	searchResult result;
+} searchJob;
+
+static void searchInitState(searchState *s, aiContext *ctx, board *root, searchLimits limits, int threadIndex)
+{
+	memset(s, 0, sizeof(searchState));
+	s->ctx = ctx;
+	s->tt = ctx->tt;
+	s->limits = limits;
+	s->threadIndex = threadIndex;
+	s->clock = limits.timeMs > 0 ? sfClock_create() : NULL;
+	atomic_init(&s->sharedNodes, 0);
+
+	memcpy(&s->boards[0], root, sizeof(board));
+	s->keys[0] = zobristHash(&s->boards[0]);
+
+	// A history which doesn't end in the root belongs to some other position, so it's no use
+	const keyHistory *h = ctx->history;
+	if (h && h->size > 0 && h->keys[h->size - 1] == s->keys[0])
+	{
+		int length = h->size - 1;
+		if (length > (int) root->halfMoveClock)
+			length = root->halfMoveClock;
+		if (length > SEARCH_MAX_HISTORY)
+			length = SEARCH_MAX_HISTORY;
+
+		memcpy(s->history, h->keys + h->size - 1 - length, length * sizeof(uint64_t));
+		s->historyLength = length;
+	}
+}
+
+// Nodes searched by every thread so far. The other threads' counts are a little behind
+static unsigned long long searchTotalNodes(searchJob *job)
+{
+	unsigned long long nodes = job->states[0]->nodes;
+	for (int i = 1; i < job->numThreads; i++)
+		nodes += atomic_load_explicit(&job->states[i]->sharedNodes, memory_order_relaxed);
+	return nodes;
+}
+
+static void searchMain(searchJob *job)
+{
+	searchState *s = job->states[0];
+	searchResult *result = &job->result;
+
+	for (int depth = 1; depth <= job->maxDepth; depth++)
+	{
+		// Each line after the first is the best line left once the moves of the lines before it are taken away
+		searchLine lines[SEARCH_MAX_LINES];
+		s->numExcluded = 0;
+
+		for (int i = 0; i < job->numLines; i++)
+		{
+			int score = negamax(s, 0, depth, -SCORE_INFINITE, SCORE_INFINITE);
+			if (s->stopped)
+				break;
+
+			extractLine(s, s->rootBest, score, &lines[i]);
+			s->excluded[s->numExcluded++] = s->rootBest;
+		}
+
+		// An unfinished iteration can't be trusted, so keep the result of the previous one
+		if (s->stopped)
+			break;
+
+		memcpy(result->lines, lines, job->numLines * sizeof(searchLine));
+		result->numLines = job->numLines;
+		result->best = lines[0].moves[0];
+		result->score = lines[0].score;
+		result->depth = depth;
+		result->nodes = searchTotalNodes(job);
+
+		if (s->limits.onIteration)
+			s->limits.onIteration(result, s->limits.userData);
+
+		// No point searching deeper once a forced mate has been found
+		if (result->score >= SCORE_MATE_BOUND || result->score <= -SCORE_MATE_BOUND)
+			break;
+	}
+}
+
+// Helpers search the same position with no limits of their own until the main search is done. Half of them start a ply
+// deeper, and each orders the root moves differently, so they spread out over the tree instead of repeating the main
+// search. What they find reaches the main search through the transposition table
+static void searchHelper(searchJob *job, searchState *s)
+{
+	for (int depth = 1 + s->threadIndex % 2; depth <= job->maxDepth; depth++)
+	{
+		int score = negamax(s, 0, depth, -SCORE_INFINITE, SCORE_INFINITE);
+		if (s->stopped)
+			break;
+
+		if (score >= SCORE_MATE_BOUND || score <= -SCORE_MATE_BOUND)
+			break;
+	}
+
+	atomic_store_explicit(&s->sharedNodes, s->nodes, memory_order_relaxed);
+}
+
+static void searchTask(void *userData, int workerIndex, int taskIndex)
+{
+	(void) workerIndex;
+
+	searchJob *job = (searchJob *) userData;
+
+	if (taskIndex == 0)
+	{
+		searchMain(job);
+		atomic_store_explicit(&job->helperStop, 1, memory_order_relaxed);
+	}
+	else
+	{
+		searchHelper(job, job->states[taskIndex]);
+	}
+}
+
+searchResult searchRun(aiContext *ctx, chess *c, searchLimits limits)
+{
+	arenaReset(&ctx->scratch);
+
+	// Without a shared table the helpers would have no way to help, so they only run with one
+	searchJob job;
+	job.numThreads = ctx->pool && ctx->tt ? threadPoolGetSize(ctx->pool) : 1;
+	job.states = (searchState **) arenaAlloc(&ctx->scratch, job.numThreads * sizeof(searchState *));
+	atomic_init(&job.helperStop, 0);
+
+	// The main search carries on with the context's random numbers, so a single thread plays exactly as it always has
+	board *root = chessGetBoard(c);
+	for (int i = 0; i < job.numThreads; i++)
+	{
+		searchLimits helperLimits = {0, 0, 0, 0, NULL, NULL};
+		job.states[i] = (searchState *) arenaAlloc(&ctx->scratch, sizeof(searchState));
+		searchInitState(job.states[i], ctx, root, i == 0 ? limits : helperLimits, i);
+
+		if (i == 0)
+		{
+			job.states[i]->r = ctx->r;
+		}
+		else
+		{
+			rngSeed(&job.states[i]->r, rngNext(&ctx->r));
+			job.states[i]->helperStop = &job.helperStop;
+		}
+	}
+
+	if (ctx->tt)
+		ttNewSearch(ctx->tt);
+
+	searchResult *result = &job.result;
+	result->best = chessGetLegalMoves(c)->head->move;
+	result->score = 0;
+	result->depth = 0;
+	result->lines[0].moves[0] = result->best;
+	result->lines[0].length = 1;
+	result->lines[0].score = 0;
+	result->numLines = 1;
+
+	job.maxDepth = limits.depth > 0 && limits.depth < SEARCH_MAX_PLY ? limits.depth : SEARCH_MAX_PLY;
+
+	job.numLines = limits.multiPv > 1 ? limits.multiPv : 1;
+	if (job.numLines > SEARCH_MAX_LINES)
+		job.numLines = SEARCH_MAX_LINES;
+	if (job.numLines > (int) chessGetLegalMoves(c)->size)
+		job.numLines = chessGetLegalMoves(c)->size;
+
+	if (job.numThreads > 1)
+		threadPoolRun(ctx->pool, searchTask, &job, job.numThreads);
+	else
+		searchMain(&job);
+
+	ctx->r = job.states[0]->r;
+
+	result->nodes = 0;
+	for (int i = 0; i < job.numThreads; i++)
+	{
+		result->nodes += job.states[i]->nodes;
+		if (job.states[i]->clock)
+			sfClock_destroy(job.states[i]->clock);
+	}
+
+	return *result;
+}
+
+size_t searchScratchSize(int numThreads)
+{
+	// Each allocation may be padded out to the next cache line
+	return numThreads * (sizeof(searchState *) + sizeof(searchState) + ARENA_ALIGNMENT) + ARENA_ALIGNMENT;
+}
+
+int searchTimeForMove(int clockMs, int incrementMs, int movesToGo, int overheadMs)
+{
+	if (movesToGo <= 0)
+		movesToGo = SEARCH_DEFAULT_MOVES_TO_GO;
+
+	// Spread the clock evenly over the moves still to play, and spend most of the increment straight away
+	int timeMs = clockMs / movesToGo + incrementMs * 3 / 4;
+	if (timeMs > clockMs - overheadMs)
+		timeMs = clockMs - overheadMs;
+
+	return timeMs > 1 ? timeMs : 1;
+}
@@ -0,0 +1,81 @@
+/*
+ * Alpha-beta search declarations
+ */
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "chesslib/chess.h"
+
+#include "ai.h"
+
+#define SEARCH_MAX_PLY 64
+
+// The most positions from before the root that a search looks back through for repetitions. The 75 move rule ends the
+// game after this many plies without a capture or pawn move, so nothing further back can ever repeat
+#define SEARCH_MAX_HISTORY 150
+
+// The most lines a multi-PV search can find, and the most moves kept of each line
+#define SEARCH_MAX_LINES 8
+#define SEARCH_MAX_PV_LENGTH 16
+
+#define SCORE_INFINITE 32001
+#define SCORE_MATE 32000
+
+// Any score past this is a forced mate
+#define SCORE_MATE_BOUND (SCORE_MATE - SEARCH_MAX_PLY)
+
+// How many nodes are searched between looks at the clock. Must be a power of two
+#define SEARCH_TIME_CHECK_NODES 1024
+
+// When playing on a clock without being told how many moves are left, plan on this many more
+#define SEARCH_DEFAULT_MOVES_TO_GO 30
+
+// A line of play the search expects, starting with the move it is about
+typedef struct
+{
+	move moves[SEARCH_MAX_PV_LENGTH];
+	int length;
+	int score; // Centipawns from the point of view of the player to move
+} searchLine;
+
+typedef struct
+{
+	move best;
+	int score; // Centipawns from the point of view of the player to move
+	int depth; // The deepest iteration that finished
+	unsigned long long nodes;
+
+	// The best lines found, best first. The first one always starts with best
+	searchLine lines[SEARCH_MAX_LINES];
+	int numLines;
+} searchResult;
+
+typedef struct
+{
+	int depth; // 0 means no limit (other than SEARCH_MAX_PLY)
+	unsigned long long nodes; // 0 means no limit
+	int timeMs; // 0 means no limit
+
+	// How many of the best moves to find lines for, up to SEARCH_MAX_LINES. 0 means just the best one. Every extra
+	// line costs about as much as the first
+	int multiPv;
+
+	// Called on the searching thread with the result of every iteration as soon as it finishes. May be NULL
+	void (*onIteration)(const searchResult *result, void *userData);
+	void *userData;
+} searchLimits;
+
+// Iterative deepening negamax alpha-beta search of the current position of c. Stops at the limits, or as soon as
+// ctx is told to stop, and returns the result of the last iteration that finished. The game must not be over
+searchResult searchRun(aiContext *ctx, chess *c, searchLimits limits);
+
+// How much of the context's arena searchRun uses when running on the given number of threads
+size_t searchScratchSize(int numThreads);
+
+// How long to think about one move with the given time left on the clock and increment per move, all in milliseconds.
+// movesToGo is the number of moves until the next time control, or 0 if unknown. overheadMs is kept back for whatever
+// happens around the search, like talking to a GUI
+int searchTimeForMove(int clockMs, int incrementMs, int movesToGo, int overheadMs);
+
+#endif
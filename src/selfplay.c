@@ -0,0 +1,146 @@
+/*
+ * Headless self-play implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <SFML/System.h>
+
+#include "chesslib/chess.h"
+
+#include "selfplay.h"
+#include "ai.h"
+#include "threadpool.h"
+
+#define TS_COUNT (tsDrawInsufficient + 1)
+
+// Owned by one worker thread, merged after all games are finished
+typedef struct
+{
+	aiContext ctx;
+	int whiteWins;
+	int blackWins;
+	int terminalStates[TS_COUNT];
+	unsigned long long plies;
+} selfPlayWorker;
+
+typedef struct
+{
+	const char *fen;
+	uint64_t seed;
+	selfPlayWorker *workers;
+} selfPlayJob;
+
+static void selfPlayGame(void *userData, int workerIndex, int gameIndex)
+{
+	selfPlayJob *job = (selfPlayJob *) userData;
+	selfPlayWorker *w = &job->workers[workerIndex];
+
+	// Seed per game rather than per thread, so that a given seed plays the same games for any thread count
+	aiNewGame(&w->ctx, job->seed + (uint64_t) gameIndex);
+
+	chess *c = chessCreateFen(job->fen);
+
+	while (chessGetTerminalState(c) == tsOngoing)
+	{
+		move m = aiGetMove(&w->ctx, c);
+		chessPlayMove(c, m);
+		w->plies++;
+	}
+
+	terminalState ts = chessGetTerminalState(c);
+	w->terminalStates[ts]++;
+	if (ts == tsCheckmate)
+	{
+		if (chessGetPlayer(c) == pcWhite)
+			w->blackWins++;
+		else
+			w->whiteWins++;
+	}
+
+	chessFree(c);
+}
+
+static void printResult(const char *name, int count, int total)
+{
+	printf("  %-14s %8d  (%5.1f%%)\n", name, count, total ? 100.0 * count / total : 0.0);
+}
+
+int selfPlayRun(int numGames, int numThreads, const char *fen, uint64_t seed)
+{
+	if (numGames <= 0)
+	{
+		fprintf(stderr, "ERROR: The number of self-play games must be positive\n");
+		return 1;
+	}
+
+	if (numThreads <= 0)
+		numThreads = threadPoolGetCpuCount();
+	if (numThreads > numGames)
+		numThreads = numGames;
+
+	threadPool *pool = threadPoolCreate(numThreads);
+
+	selfPlayJob job;
+	job.fen = fen;
+	job.seed = seed;
+	job.workers = (selfPlayWorker *) calloc(numThreads, sizeof(selfPlayWorker));
+
+	for (int i = 0; i < numThreads; i++)
+		aiInit(&job.workers[i].ctx, seed);
+
+	printf("Playing %d games from \"%s\" on %d threads (seed %llu)\n", numGames, fen, numThreads,
+			(unsigned long long) seed);
+	fflush(stdout);
+
+	sfClock *clock = sfClock_create();
+
+	threadPoolRun(pool, selfPlayGame, &job, numGames);
+
+	float seconds = sfTime_asSeconds(sfClock_getElapsedTime(clock));
+	sfClock_destroy(clock);
+
+	// Merge the per-worker tallies
+	int whiteWins = 0;
+	int blackWins = 0;
+	int terminalStates[TS_COUNT] = {0};
+	unsigned long long plies = 0;
+	unsigned long long arenaGrowths = 0;
+
+	for (int i = 0; i < numThreads; i++)
+	{
+		selfPlayWorker *w = &job.workers[i];
+
+		whiteWins += w->whiteWins;
+		blackWins += w->blackWins;
+		plies += w->plies;
+		arenaGrowths += w->ctx.scratch.growths;
+		for (int j = 0; j < TS_COUNT; j++)
+			terminalStates[j] += w->terminalStates[j];
+
+		aiFree(&w->ctx);
+	}
+
+	free(job.workers);
+	threadPoolFree(pool);
+
+	if (seconds <= 0.0f)
+		seconds = 1e-6f;
+
+	printf("Finished in %.3f s\n", seconds);
+	printf("  %-14s %8.1f\n", "Games/sec", numGames / seconds);
+	printf("  %-14s %8.0f\n", "Plies/sec", plies / seconds);
+	printf("  %-14s %8.1f\n", "Avg plies", (double) plies / numGames);
+	printf("  %-14s %8llu\n", "AI heap allocs", arenaGrowths);
+	printf("Results:\n");
+	printResult("White wins", whiteWins, numGames);
+	printResult("Black wins", blackWins, numGames);
+	printResult("Stalemate", terminalStates[tsDrawStalemate], numGames);
+	printResult("75 move rule", terminalStates[tsDraw75MoveRule], numGames);
+	printResult("Fivefold", terminalStates[tsDrawFivefold], numGames);
+	printResult("Insufficient", terminalStates[tsDrawInsufficient], numGames);
+
+	return 0;
+}
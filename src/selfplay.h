@@ -0,0 +1,15 @@
+/*
+ * Headless self-play declarations
+ */
+
+#ifndef SELFPLAY_H
+#define SELFPLAY_H
+
+#include <stdint.h>
+
+// Plays the given number of complete bot-vs-bot games starting from fen, spread over numThreads worker threads, and
+// prints throughput and the result distribution to stdout. If numThreads is 0, one thread per core is used.
+// Returns the process exit code
+int selfPlayRun(int numGames, int numThreads, const char *fen, uint64_t seed);
+
+#endif
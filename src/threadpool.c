@@ -0,0 +1,126 @@
+/*
+ * Thread pool implementation
+ */
+
+#include <stdlib.h>
+#include <stdatomic.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <SFML/System.h>
+
+#include "threadpool.h"
+
+typedef struct
+{
+	threadPool *pool;
+	int index;
+} threadPoolWorker;
+
+struct threadPool
+{
+	int numThreads;
+
+	// CSFML has no condition variables to park idle threads on, so the helper threads are launched for each batch and
+	// exit when it runs out of tasks. That keeps an idle pool at zero CPU
+	sfThread **threads;
+	threadPoolWorker *workers;
+
+	// The batch currently running
+	threadPoolTask task;
+	void *userData;
+	int count;
+	atomic_int nextTask;
+};
+
+int threadPoolGetCpuCount()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int) info.dwNumberOfProcessors;
+#else
+	long count = sysconf(_SC_NPROCESSORS_ONLN);
+	return count > 0 ? (int) count : 1;
+#endif
+}
+
+static void threadPoolWorkerRun(void *userData)
+{
+	threadPoolWorker *w = (threadPoolWorker *) userData;
+	threadPool *pool = w->pool;
+
+	int i;
+	while ((i = atomic_fetch_add_explicit(&pool->nextTask, 1, memory_order_relaxed)) < pool->count)
+		pool->task(pool->userData, w->index, i);
+}
+
+threadPool *threadPoolCreate(int numThreads)
+{
+	if (numThreads <= 0)
+		numThreads = threadPoolGetCpuCount();
+
+	threadPool *pool = (threadPool *) malloc(sizeof(threadPool));
+	pool->numThreads = numThreads;
+	pool->workers = (threadPoolWorker *) malloc(numThreads * sizeof(threadPoolWorker));
+	pool->threads = (sfThread **) malloc(numThreads * sizeof(sfThread *));
+
+	for (int i = 0; i < numThreads; i++)
+	{
+		pool->workers[i].pool = pool;
+		pool->workers[i].index = i;
+
+		// Worker 0 is whichever thread calls threadPoolRun
+		pool->threads[i] = i == 0 ? NULL : sfThread_create(threadPoolWorkerRun, &pool->workers[i]);
+	}
+
+	atomic_init(&pool->nextTask, 0);
+
+	return pool;
+}
+
+void threadPoolFree(threadPool *pool)
+{
+	if (!pool)
+		return;
+
+	for (int i = 1; i < pool->numThreads; i++)
+		sfThread_destroy(pool->threads[i]);
+
+	free(pool->threads);
+	free(pool->workers);
+	free(pool);
+}
+
+int threadPoolGetSize(threadPool *pool)
+{
+	return pool->numThreads;
+}
+
+void threadPoolRun(threadPool *pool, threadPoolTask task, void *userData, int count)
+{
+	if (count <= 0)
+		return;
+
+	pool->task = task;
+	pool->userData = userData;
+	pool->count = count;
+	atomic_store_explicit(&pool->nextTask, 0, memory_order_relaxed);
+
+	// Launching a thread publishes everything written above to it
+	int helpers = pool->numThreads - 1;
+	if (helpers > count - 1)
+		helpers = count - 1;
+
+	for (int i = 1; i <= helpers; i++)
+		sfThread_launch(pool->threads[i]);
+
+	threadPoolWorkerRun(&pool->workers[0]);
+
+	for (int i = 1; i <= helpers; i++)
+		sfThread_wait(pool->threads[i]);
+}
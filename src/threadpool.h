@@ -0,0 +1,27 @@
+/*
+ * Thread pool declarations
+ */
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+typedef struct threadPool threadPool;
+
+// A task is called once for every index in the batch. workerIndex is in the range [0, threadPoolGetSize(pool)) and
+// identifies which worker is running it, so that tasks can use per-worker scratch memory without locking
+typedef void (*threadPoolTask)(void *userData, int workerIndex, int taskIndex);
+
+// Returns the number of logical cores on this machine
+int threadPoolGetCpuCount();
+
+// Creates a pool with the given number of workers, including the calling thread. 0 means one per core
+threadPool *threadPoolCreate(int numThreads);
+void threadPoolFree(threadPool *pool);
+
+int threadPoolGetSize(threadPool *pool);
+
+// Runs task for every index in [0, count), spread over the pool, and returns once they have all finished. The calling
+// thread works on the batch as worker 0. A pool only runs one batch at a time
+void threadPoolRun(threadPool *pool, threadPoolTask task, void *userData, int count);
+
+#endif
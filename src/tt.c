@@ -0,0 +1,199 @@
+/*
+ * Transposition table implementation
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "tt.h"
+
+#define CACHE_LINE_SIZE 64
+
+// Layout of ttEntry.data:
+//   bits  0-15  move (from index, to index, promotion)
+//   bits 16-31  score
+//   bits 32-39  depth
+//   bits 40-41  bound
+//   bits 42-47  generation
+
+static uint16_t ttPackMove(move m)
+{
+	if (m.from.file == 0)
+		return 0;
+
+	int from = 8 * (m.from.rank - 1) + (m.from.file - 1);
+	int to = 8 * (m.to.rank - 1) + (m.to.file - 1);
+
+	return (uint16_t) (from | (to << 6) | ((int) m.promotion << 12));
+}
+
+static move ttUnpackMove(uint16_t packed)
+{
+	move m;
+	if (packed == 0)
+	{
+		m.from = SQ_INVALID;
+		m.to = SQ_INVALID;
+		m.promotion = ptEmpty;
+		return m;
+	}
+
+	int from = packed & 63;
+	int to = (packed >> 6) & 63;
+
+	m.from = (sq) {(from % 8) + 1, (from / 8) + 1};
+	m.to = (sq) {(to % 8) + 1, (to / 8) + 1};
+	m.promotion = (pieceType) ((packed >> 12) & 7);
+	return m;
+}
+
+static uint64_t ttPack(move m, int score, int depth, ttBound bound, uint8_t generation)
+{
+	return (uint64_t) ttPackMove(m)
+			| ((uint64_t) (uint16_t) (int16_t) score << 16)
+			| ((uint64_t) (uint8_t) depth << 32)
+			| ((uint64_t) bound << 40)
+			| ((uint64_t) (generation & 63) << 42);
+}
+
+static int ttDataDepth(uint64_t data)
+{
+	return (int) ((data >> 32) & 0xFF);
+}
+
+static uint8_t ttDataGeneration(uint64_t data)
+{
+	return (uint8_t) ((data >> 42) & 63);
+}
+
+ttTable *ttCreate(int sizeMb)
+{
+	if (sizeMb < 1)
+		sizeMb = 1;
+
+	// Round down to a power of two so that the bucket index is just a mask
+	size_t numBuckets = 1;
+	while (numBuckets * 2 * sizeof(ttBucket) <= (size_t) sizeMb * 1024 * 1024)
+		numBuckets *= 2;
+
+	ttTable *tt = (ttTable *) malloc(sizeof(ttTable));
+	if (!tt)
+		return NULL;
+
+	tt->memory = malloc(numBuckets * sizeof(ttBucket) + CACHE_LINE_SIZE - 1);
+	if (!tt->memory)
+	{
+		free(tt);
+		return NULL;
+	}
+
+	uintptr_t aligned = ((uintptr_t) tt->memory + CACHE_LINE_SIZE - 1) & ~(uintptr_t) (CACHE_LINE_SIZE - 1);
+	tt->buckets = (ttBucket *) aligned;
+	tt->numBuckets = numBuckets;
+
+	ttClear(tt);
+
+	return tt;
+}
+
+void ttFree(ttTable *tt)
+{
+	if (!tt)
+		return;
+
+	free(tt->memory);
+	free(tt);
+}
+
+void ttClear(ttTable *tt)
+{
+	memset(tt->buckets, 0, tt->numBuckets * sizeof(ttBucket));
+	tt->generation = 0;
+}
+
+void ttNewSearch(ttTable *tt)
+{
+	tt->generation = (tt->generation + 1) & 63;
+}
+
+static ttBucket *ttGetBucket(ttTable *tt, uint64_t key)
+{
+	return &tt->buckets[key & (tt->numBuckets - 1)];
+}
+
+// Entries are read and written with relaxed atomics, which cost nothing over plain loads and stores. Torn entries are
+// caught by the XOR check instead
+static int ttLoadEntry(ttEntry *e, uint64_t *key, uint64_t *data)
+{
+	*data = atomic_load_explicit(&e->data, memory_order_relaxed);
+	*key = atomic_load_explicit(&e->key, memory_order_relaxed) ^ *data;
+	return *data != 0;
+}
+
+int ttProbe(ttTable *tt, uint64_t key, ttData *out)
+{
+	ttBucket *bucket = ttGetBucket(tt, key);
+
+	for (int i = 0; i < TT_BUCKET_ENTRIES; i++)
+	{
+		uint64_t entryKey, data;
+		if (ttLoadEntry(&bucket->entries[i], &entryKey, &data) && entryKey == key)
+		{
+			out->m = ttUnpackMove((uint16_t) (data & 0xFFFF));
+			out->score = (int16_t) ((data >> 16) & 0xFFFF);
+			out->depth = ttDataDepth(data);
+			out->bound = (ttBound) ((data >> 40) & 3);
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+void ttStore(ttTable *tt, uint64_t key, move m, int score, int depth, ttBound bound)
+{
+	ttBucket *bucket = ttGetBucket(tt, key);
+
+	// Overwrite the same position if it's there, otherwise replace whichever entry is the least useful: empty entries
+	// first, then entries from older searches, then the shallowest
+	ttEntry *replace = &bucket->entries[0];
+	uint64_t replaceData = 0;
+	int replaceValue = 1 << 30;
+	int samePosition = 0;
+
+	for (int i = 0; i < TT_BUCKET_ENTRIES; i++)
+	{
+		ttEntry *e = &bucket->entries[i];
+
+		uint64_t entryKey, data;
+		int isUsed = ttLoadEntry(e, &entryKey, &data);
+
+		if (isUsed && entryKey == key)
+		{
+			replace = e;
+			replaceData = data;
+			samePosition = 1;
+			break;
+		}
+
+		int value;
+		if (!isUsed)
+			value = -1000;
+		else
+			value = ttDataDepth(data) - (ttDataGeneration(data) == tt->generation ? 0 : 256);
+
+		if (value < replaceValue)
+		{
+			replace = e;
+			replaceValue = value;
+		}
+	}
+
+	// Keep the old best move if we don't have a new one for the same position
+	if (m.from.file == 0 && samePosition)
+		m = ttUnpackMove((uint16_t) (replaceData & 0xFFFF));
+
+	uint64_t data = ttPack(m, score, depth, bound, tt->generation);
+	atomic_store_explicit(&replace->data, data, memory_order_relaxed);
+	atomic_store_explicit(&replace->key, key ^ data, memory_order_relaxed);
+}
@@ -0,0 +1,72 @@
+/*
+ * Transposition table declarations
+ */
+
+#ifndef TT_H
+#define TT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include "chesslib/move.h"
+
+// Four 16 byte entries make up one 64 byte bucket, and buckets are aligned to cache lines, so a probe touches exactly
+// one cache line
+#define TT_BUCKET_ENTRIES 4
+
+typedef enum
+{
+	ttNone = 0,
+	ttUpper,
+	ttLower,
+	ttExact,
+} ttBound;
+
+// Several search threads share one table without any locks. Each half of an entry is written atomically, but another
+// thread can still see the key of one store next to the data of another. So the key is stored XORed with the data, and
+// a probe only accepts an entry if XORing them gives back the key it was looking for
+typedef struct
+{
+	_Atomic uint64_t key;
+	_Atomic uint64_t data;
+} ttEntry;
+
+typedef struct
+{
+	ttEntry entries[TT_BUCKET_ENTRIES];
+} ttBucket;
+
+typedef struct
+{
+	ttBucket *buckets;
+	size_t numBuckets; // Always a power of two
+	uint8_t generation;
+	void *memory; // The unaligned pointer returned by malloc
+} ttTable;
+
+// What a probe hands back. The move has a promotion of ptEmpty and an invalid from square if there is no move stored
+typedef struct
+{
+	move m;
+	int score;
+	int depth;
+	ttBound bound;
+} ttData;
+
+// Returns NULL if the memory can't be allocated
+ttTable *ttCreate(int sizeMb);
+void ttFree(ttTable *tt);
+
+// Only call these while no search is using the table
+void ttClear(ttTable *tt);
+
+// Call at the start of every search so that entries from older searches get replaced first
+void ttNewSearch(ttTable *tt);
+
+// Returns true and fills in out if the position is in the table. Probes and stores are safe to call from several
+// threads at once
+int ttProbe(ttTable *tt, uint64_t key, ttData *out);
+void ttStore(ttTable *tt, uint64_t key, move m, int score, int depth, ttBound bound);
+
+#endif
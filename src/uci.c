@@ -0,0 +1,456 @@
+/*
+ * UCI engine mode implementation
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+
+#include <SFML/System.h>
+
+#include "chesslib/chess.h"
+
+#include "uci.h"
+#include "ai.h"
+#include "search.h"
+#include "notation.h"
+#include "threadpool.h"
+#include "keyhistory.h"
+
+// Long enough for "position startpos moves" followed by a few thousand moves
+#define UCI_LINE_LENGTH 32768
+
+#define UCI_ENGINE_NAME "sfml-chess-test"
+#define UCI_ENGINE_AUTHOR "thearst3rd"
+
+// Time kept back from every move for the GUI and the pipes, so the engine never loses on time by a hair
+#define UCI_MOVE_OVERHEAD_MS 30
+
+// How often a "go infinite" search which has run out of depth checks whether it has been told to stop
+#define UCI_STOP_POLL_INTERVAL_MS 1
+
+#define UCI_MAX_HASH_MB 4096
+#define UCI_MAX_THREADS 256
+
+typedef struct
+{
+	searchLimits limits;
+	int infinite;
+} uciGo;
+
+static aiContext ctx;
+static chess *game = NULL;
+
+// Every position of the game since "position", so the search can steer clear of repeating them, or aim for it
+static keyHistory gameKeys;
+
+static sfThread *searchThread = NULL;
+static sfClock *searchClock = NULL;
+static sfMutex *outputMutex = NULL;
+
+// Set by the main thread to stop a search early
+static atomic_int stop;
+
+// Only touched by the main thread. The search thread reads it, but it never changes while a search is running
+static uciGo currentGo;
+static int searching = 0;
+static int multiPv = 1;
+
+// Both threads write to stdout, so every line goes out whole and right away
+static void uciSend(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+
+	sfMutex_lock(outputMutex);
+	vprintf(format, args);
+	printf("\n");
+	fflush(stdout);
+	sfMutex_unlock(outputMutex);
+
+	va_end(args);
+}
+
+static int uciElapsedMs()
+{
+	return sfTime_asMilliseconds(sfClock_getElapsedTime(searchClock));
+}
+
+static void uciReportIteration(const searchResult *result, void *userData)
+{
+	(void) userData;
+
+	int ms = uciElapsedMs();
+	unsigned long long nps = result->nodes * 1000ULL / (unsigned long long) (ms > 0 ? ms : 1);
+
+	for (int i = 0; i < result->numLines; i++)
+	{
+		const searchLine *line = &result->lines[i];
+
+		// Mate scores are given in moves rather than plies, negative if the engine is the one getting mated
+		char score[32];
+		if (line->score >= SCORE_MATE_BOUND || line->score <= -SCORE_MATE_BOUND)
+		{
+			int plies = SCORE_MATE - abs(line->score);
+			sprintf(score, "mate %d", line->score > 0 ? (plies + 1) / 2 : -(plies / 2));
+		}
+		else
+		{
+			sprintf(score, "cp %d", line->score);
+		}
+
+		char pv[SEARCH_MAX_PV_LENGTH * NOTATION_UCI_LENGTH];
+		int length = 0;
+		for (int j = 0; j < line->length; j++)
+		{
+			if (j > 0)
+				pv[length++] = ' ';
+			notationMoveToUci(line->moves[j], pv + length);
+			length += strlen(pv + length);
+		}
+		pv[length] = '\0';
+
+		uciSend("info depth %d multipv %d score %s nodes %llu nps %llu time %d pv %s", result->depth, i + 1, score,
+				result->nodes, nps, ms, pv);
+	}
+}
+
+static void uciSearch(void *userData)
+{
+	(void) userData;
+
+	move m;
+	int found = 0;
+
+	if (chessGetLegalMoves(game)->size == 0)
+	{
+		// Nothing to search. "0000" is the null move
+	}
+	else if (aiConfig.book && bookProbe(aiConfig.book, chessGetBoard(game), &ctx.r, &m))
+	{
+		found = 1;
+	}
+	else
+	{
+		searchResult result = searchRun(&ctx, game, currentGo.limits);
+		m = result.best;
+		found = 1;
+
+		// A depth 0 search never reaches onIteration, but the GUI still wants to hear how much was searched
+		if (result.depth == 0)
+			uciReportIteration(&result, NULL);
+	}
+
+	// With "go infinite" the best move may only be sent once the GUI says stop, even if the search ran out of depth
+	while (currentGo.infinite && !atomic_load_explicit(&stop, memory_order_relaxed))
+		sfSleep(sfMilliseconds(UCI_STOP_POLL_INTERVAL_MS));
+
+	if (found)
+	{
+		char str[NOTATION_UCI_LENGTH];
+		notationMoveToUci(m, str);
+		uciSend("bestmove %s", str);
+	}
+	else
+	{
+		uciSend("bestmove 0000");
+	}
+}
+
+// Stops a running search and waits for it to send its best move. Does nothing if no search is running
+static void uciStopSearch()
+{
+	if (!searching)
+		return;
+
+	atomic_store_explicit(&stop, 1, memory_order_relaxed);
+	sfThread_wait(searchThread);
+
+	searching = 0;
+}
+
+static void uciPosition(char *args)
+{
+	char *token = strtok(args, " \t");
+	if (!token)
+		return;
+
+	char fen[UCI_LINE_LENGTH];
+	if (strcmp(token, "startpos") == 0)
+	{
+		strcpy(fen, INITIAL_FEN);
+		token = strtok(NULL, " \t");
+	}
+	else if (strcmp(token, "fen") == 0)
+	{
+		// The FEN is every field up to "moves", if there are any
+		fen[0] = '\0';
+		while ((token = strtok(NULL, " \t")) && strcmp(token, "moves") != 0)
+		{
+			if (fen[0])
+				strcat(fen, " ");
+			strcat(fen, token);
+		}
+	}
+	else
+	{
+		uciSend("info string Unknown position type %s", token);
+		return;
+	}
+
+	// A bad FEN leaves the previous position alone, so a later "go" still has something to search
+	chess *newGame = chessCreateFen(fen);
+	if (!newGame)
+	{
+		uciSend("info string Invalid FEN %s", fen);
+		return;
+	}
+
+	if (game)
+		chessFree(game);
+	game = newGame;
+	keyHistoryReset(&gameKeys, game);
+
+	if (!token || strcmp(token, "moves") != 0)
+		return;
+
+	while ((token = strtok(NULL, " \t")))
+	{
+		move m;
+		if (!notationMoveFromUci(token, &m) || keyHistoryPlayMove(&gameKeys, game, m))
+		{
+			uciSend("info string Illegal move %s", token);
+			return;
+		}
+	}
+}
+
+static void uciStartGo(char *args)
+{
+	uciGo go;
+	go.limits.depth = 0;
+	go.limits.nodes = 0;
+	go.limits.timeMs = 0;
+	go.limits.multiPv = multiPv;
+	go.limits.onIteration = uciReportIteration;
+	go.limits.userData = NULL;
+	go.infinite = 0;
+
+	int moveTime = 0;
+	int clockTime[2] = {0, 0};
+	int increment[2] = {0, 0};
+	int movesToGo = 0;
+
+	// Flags stand alone and searchmoves is followed by a list of moves, every other keyword by one number
+	char *token = strtok(args, " \t");
+	while (token)
+	{
+		char *next = strtok(NULL, " \t");
+
+		if (strcmp(token, "infinite") == 0 || strcmp(token, "ponder") == 0)
+		{
+			// A ponder search may not send its best move before the GUI says stop or ponderhit either
+			go.infinite = 1;
+		}
+		else if (strcmp(token, "searchmoves") == 0)
+		{
+			// Not supported, every move is searched. Skip the list up to the next keyword
+			move m;
+			while (next && notationMoveFromUci(next, &m))
+				next = strtok(NULL, " \t");
+		}
+		else if (next)
+		{
+			int hasValue = 1;
+
+			if (strcmp(token, "depth") == 0)
+				go.limits.depth = atoi(next);
+			else if (strcmp(token, "mate") == 0)
+				go.limits.depth = 2 * atoi(next) - 1;
+			else if (strcmp(token, "nodes") == 0)
+				go.limits.nodes = strtoull(next, NULL, 10);
+			else if (strcmp(token, "movetime") == 0)
+				moveTime = atoi(next);
+			else if (strcmp(token, "wtime") == 0)
+				clockTime[0] = atoi(next);
+			else if (strcmp(token, "btime") == 0)
+				clockTime[1] = atoi(next);
+			else if (strcmp(token, "winc") == 0)
+				increment[0] = atoi(next);
+			else if (strcmp(token, "binc") == 0)
+				increment[1] = atoi(next);
+			else if (strcmp(token, "movestogo") == 0)
+				movesToGo = atoi(next);
+			else
+				hasValue = 0; // Unknown, and assumed to be a flag
+
+			if (hasValue)
+				next = strtok(NULL, " \t");
+		}
+
+		token = next;
+	}
+
+	int side = chessGetPlayer(game) == pcWhite ? 0 : 1;
+	if (moveTime > 0)
+		go.limits.timeMs = moveTime;
+	else if (clockTime[side] > 0)
+		go.limits.timeMs = searchTimeForMove(clockTime[side], increment[side], movesToGo, UCI_MOVE_OVERHEAD_MS);
+
+	if (!ctx.tt)
+		ctx.tt = ttCreate(aiConfig.hashSizeMb);
+
+	currentGo = go;
+	atomic_store_explicit(&stop, 0, memory_order_relaxed);
+	sfClock_restart(searchClock);
+
+	sfThread_launch(searchThread);
+
+	searching = 1;
+}
+
+static void uciSetOption(char *args)
+{
+	// Only "setoption name <Hash, MultiPV or Threads> value <N>" is supported
+	char *name = strtok(args, " \t");
+	char *option = strtok(NULL, " \t");
+	char *value = strtok(NULL, " \t");
+	char *amount = strtok(NULL, " \t");
+
+	if (!name || !option || !value || !amount || strcmp(name, "name") != 0 || strcmp(value, "value") != 0)
+		return;
+
+	if (strcmp(option, "Hash") == 0)
+	{
+		int sizeMb = atoi(amount);
+		if (sizeMb < 1 || sizeMb > UCI_MAX_HASH_MB)
+		{
+			uciSend("info string Hash must be between 1 and %d MB", UCI_MAX_HASH_MB);
+			return;
+		}
+
+		// The table is created again at the new size on the next search
+		aiConfig.hashSizeMb = sizeMb;
+		ttFree(ctx.tt);
+		ctx.tt = NULL;
+	}
+	else if (strcmp(option, "MultiPV") == 0)
+	{
+		int lines = atoi(amount);
+		if (lines < 1 || lines > SEARCH_MAX_LINES)
+		{
+			uciSend("info string MultiPV must be between 1 and %d", SEARCH_MAX_LINES);
+			return;
+		}
+
+		multiPv = lines;
+	}
+	else if (strcmp(option, "Threads") == 0)
+	{
+		int threads = atoi(amount);
+		if (threads < 1 || threads > UCI_MAX_THREADS)
+		{
+			uciSend("info string Threads must be between 1 and %d", UCI_MAX_THREADS);
+			return;
+		}
+
+		threadPoolFree(ctx.pool);
+		aiSetPool(&ctx, threadPoolCreate(threads));
+	}
+	else
+	{
+		uciSend("info string Unknown option %s", option);
+	}
+}
+
+int uciRun(uint64_t seed, int numThreads)
+{
+	aiInit(&ctx, seed);
+	ctx.stop = &stop;
+	// Engines are often run several at a time by tournament managers, so only take every core when asked to
+	aiSetPool(&ctx, threadPoolCreate(numThreads > 0 ? numThreads : 1));
+	atomic_init(&stop, 0);
+
+	searchThread = sfThread_create(uciSearch, NULL);
+	searchClock = sfClock_create();
+	outputMutex = sfMutex_create();
+
+	game = chessCreateFen(INITIAL_FEN);
+	keyHistoryInit(&gameKeys);
+	keyHistoryReset(&gameKeys, game);
+	ctx.history = &gameKeys;
+
+	static char line[UCI_LINE_LENGTH];
+	while (fgets(line, sizeof(line), stdin))
+	{
+		line[strcspn(line, "\r\n")] = '\0';
+
+		char *command = line + strspn(line, " \t");
+		char *args = command + strcspn(command, " \t");
+		if (*args)
+			*args++ = '\0';
+
+		if (strcmp(command, "uci") == 0)
+		{
+			uciSend("id name " UCI_ENGINE_NAME);
+			uciSend("id author " UCI_ENGINE_AUTHOR);
+			uciSend("option name Hash type spin default %d min 1 max %d", aiConfig.hashSizeMb, UCI_MAX_HASH_MB);
+			uciSend("option name MultiPV type spin default 1 min 1 max %d", SEARCH_MAX_LINES);
+			uciSend("option name Threads type spin default %d min 1 max %d", threadPoolGetSize(ctx.pool),
+					UCI_MAX_THREADS);
+			uciSend("uciok");
+		}
+		else if (strcmp(command, "isready") == 0)
+		{
+			uciSend("readyok");
+		}
+		else if (strcmp(command, "ucinewgame") == 0)
+		{
+			uciStopSearch();
+			aiNewGame(&ctx, seed);
+		}
+		else if (strcmp(command, "position") == 0)
+		{
+			uciStopSearch();
+			uciPosition(args);
+		}
+		else if (strcmp(command, "go") == 0)
+		{
+			uciStopSearch();
+			uciStartGo(args);
+		}
+		else if (strcmp(command, "stop") == 0 || strcmp(command, "ponderhit") == 0)
+		{
+			// A ponder search doesn't carry on with the real clock after a ponderhit, it plays what it has found so far
+			uciStopSearch();
+		}
+		else if (strcmp(command, "setoption") == 0)
+		{
+			uciStopSearch();
+			uciSetOption(args);
+		}
+		else if (strcmp(command, "quit") == 0)
+		{
+			break;
+		}
+		else if (*command)
+		{
+			uciSend("info string Unknown command %s", command);
+		}
+	}
+
+	uciStopSearch();
+
+	chessFree(game);
+	keyHistoryFree(&gameKeys);
+	threadPoolFree(ctx.pool);
+	aiFree(&ctx);
+
+	sfThread_destroy(searchThread);
+	sfClock_destroy(searchClock);
+	sfMutex_destroy(outputMutex);
+
+	return 0;
+}
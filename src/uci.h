@@ -0,0 +1,16 @@
+/*
+ * UCI engine mode declarations
+ */
+
+#ifndef UCI_H
+#define UCI_H
+
+#include <stdint.h>
+
+// Talks the Universal Chess Interface over stdin and stdout until "quit" or the end of input, so the bot can be run by
+// tools like cutechess-cli or fastchess. Searches run on a separate thread, so "stop" and "isready" are answered while
+// thinking. The search is spread over numThreads threads, or just one if numThreads is 0, until the GUI sets the
+// Threads option. Returns the process exit code
+int uciRun(uint64_t seed, int numThreads);
+
+#endif
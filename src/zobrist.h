@@ -0,0 +1,27 @@
+/*
+ * Zobrist hashing declarations
+ */
+
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <stdint.h>
+
+#include "chesslib/board.h"
+#include "chesslib/move.h"
+
+// The key table is Polyglot's: 768 piece-square keys, 4 castling keys, 8 en passant file keys and one side-to-move key
+#define ZOBRIST_KEY_COUNT 781
+
+// Hashes a few positions with known Polyglot keys, and prints a warning for each that comes out different. Returns
+// false if any did, in which case opening books won't find their positions
+int zobristCheckKeys();
+
+// Computes the hash of a position from scratch
+uint64_t zobristHash(board *b);
+
+// Returns the hash after playing m, given the hash and board from before the move and the board after it. Only the
+// squares the move touches are looked at. DEBUG builds check the result against zobristHash
+uint64_t zobristUpdate(uint64_t hash, board *before, board *after, move m);
+
+#endif